@@ -29,4 +29,16 @@ mv game.so.temp game.so
 # Build SDL firewood 
 $CXX $CommonFlags ../src/sdl_platform.cpp -o firewood-x86_64  -L/usr/local/lib -lSDL2 -ldl -l SDL2_image $PathFlags $OpenGLFlags 
 
+# Build the event trace reader, it only needs the trace format
+$CXX $CommonFlags ../src/event_trace_reader.cpp -o event_trace_reader
+
+# Build the quad kernel benchmark, optimized so the timings mean something
+$CXX $CommonFlags -O2 ../src/quad_kernel_bench.cpp -o quad_kernel_bench -L/usr/local/lib -lSDL2 -ldl $OpenGLFlags
+
+# Build the allocator benchmark, virtual dispatch against allocateFrom/deallocateFrom
+$CXX $CommonFlags -O2 ../src/allocator_bench.cpp -o allocator_bench -L/usr/local/lib -lSDL2 -ldl $OpenGLFlags
+
+# Build the event dispatch benchmark, per-event against batched broadcast
+$CXX $CommonFlags -O2 ../src/event_dispatch_bench.cpp -o event_dispatch_bench -L/usr/local/lib -lSDL2 -ldl $OpenGLFlags
+
 popd
@@ -0,0 +1,566 @@
+#ifndef CONTAINERS_H
+#define CONTAINERS_H
+
+/************** Allocator-aware containers **********************
+################################################################
+  Engine containers take their memory from an Allocator instead of the global heap.
+  Array and HashMap give memory back when they grow, so they need an allocator that
+  supports deallocate (free list, pool, proxy). RingBuffer allocates once in init().
+*/
+
+template <typename T>
+struct Array {
+  Array() = default;
+  explicit Array(Allocator *allocator, u32 capacity = 0);
+  ~Array();
+
+  Array(const Array &) = delete;
+  Array &operator=(const Array &) = delete;
+  Array(Array &&other);
+  Array &operator=(Array &&other);
+
+  void init(Allocator *allocator, u32 capacity = 0);
+  void release();
+  void reserve(u32 new_capacity);
+  // New elements are default-initialized, so trivial types are left as they are
+  void resize(u32 new_count);
+
+  T &push(const T &value);
+  T &push(T &&value);
+  void pop();
+  void swapRemove(u32 index);
+  void clear();
+
+  inline T &operator[](u32 index) {
+    assert(index < count);
+    return data[index];
+  }
+
+  inline const T &operator[](u32 index) const {
+    assert(index < count);
+    return data[index];
+  }
+
+  inline T &back() { return (*this)[count - 1]; }
+  inline bool empty() const { return count == 0; }
+
+  inline T *begin() { return data; }
+  inline T *end() { return data + count; }
+  inline const T *begin() const { return data; }
+  inline const T *end() const { return data + count; }
+
+  Allocator *allocator = nullptr;
+  T *data = nullptr;
+  u32 count = 0;
+  u32 capacity = 0;
+};
+
+template <typename T>
+Array<T>::Array(Allocator *allocator, u32 capacity) {
+  init(allocator, capacity);
+}
+
+template <typename T>
+Array<T>::~Array() {
+  release();
+}
+
+template <typename T>
+Array<T>::Array(Array &&other)
+    : allocator{other.allocator}, data{other.data}, count{other.count}, capacity{other.capacity} {
+  other.data = nullptr;
+  other.count = 0;
+  other.capacity = 0;
+}
+
+template <typename T>
+Array<T> &Array<T>::operator=(Array &&other) {
+  if (this != &other) {
+    release();
+    allocator = other.allocator;
+    data = other.data;
+    count = other.count;
+    capacity = other.capacity;
+
+    other.data = nullptr;
+    other.count = 0;
+    other.capacity = 0;
+  }
+
+  return *this;
+}
+
+template <typename T>
+void Array<T>::init(Allocator *allocator, u32 capacity) {
+  assert(!data && "Array is already initialized");
+  this->allocator = allocator;
+  if (capacity)
+    reserve(capacity);
+}
+
+template <typename T>
+void Array<T>::release() {
+  clear();
+  if (data) {
+    allocator->deallocate(data);
+    data = nullptr;
+  }
+
+  capacity = 0;
+}
+
+template <typename T>
+void Array<T>::reserve(u32 new_capacity) {
+  if (new_capacity <= capacity)
+    return;
+
+  assert(allocator && "Array has no allocator");
+  T *new_data = reinterpret_cast<T *>(allocator->allocate(sizeof(T) * new_capacity, alignof(T) < 16 ? 16 : alignof(T)));
+  assert(new_data && "Array allocator is out of memory");
+
+  for (u32 i = 0; i < count; i++) {
+    new (&new_data[i]) T(std::move(data[i]));
+    data[i].~T();
+  }
+
+  if (data)
+    allocator->deallocate(data);
+
+  data = new_data;
+  capacity = new_capacity;
+}
+
+template <typename T>
+void Array<T>::resize(u32 new_count) {
+  reserve(new_count);
+  for (u32 i = new_count; i < count; i++) {
+    data[i].~T();
+  }
+  for (u32 i = count; i < new_count; i++) {
+    new (&data[i]) T;
+  }
+
+  count = new_count;
+}
+
+template <typename T>
+T &Array<T>::push(const T &value) {
+  if (count == capacity)
+    reserve(capacity ? capacity * 2 : 8);
+
+  return *(new (&data[count++]) T(value));
+}
+
+template <typename T>
+T &Array<T>::push(T &&value) {
+  if (count == capacity)
+    reserve(capacity ? capacity * 2 : 8);
+
+  return *(new (&data[count++]) T(std::move(value)));
+}
+
+template <typename T>
+void Array<T>::pop() {
+  assert(count > 0);
+  data[--count].~T();
+}
+
+// O(1) removal that does not keep the order
+template <typename T>
+void Array<T>::swapRemove(u32 index) {
+  assert(index < count);
+  if (index != count - 1)
+    data[index] = std::move(data[count - 1]);
+
+  pop();
+}
+
+template <typename T>
+void Array<T>::clear() {
+  for (u32 i = 0; i < count; i++) {
+    data[i].~T();
+  }
+
+  count = 0;
+}
+
+inline u64 hashKey(u64 key) {
+  // splitmix64 finalizer
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31;
+
+  return key;
+}
+
+inline u64 hashKey(u32 key) { return hashKey(static_cast<u64>(key)); }
+inline u64 hashKey(i32 key) { return hashKey(static_cast<u64>(key)); }
+inline u64 hashKey(i64 key) { return hashKey(static_cast<u64>(key)); }
+inline u64 hashKey(const void *key) { return hashKey(static_cast<u64>(reinterpret_cast<uintptr_t>(key))); }
+
+// Open addressing with linear probing. Capacity is a power of two and the table
+// grows once it is 70% full, tombstones included.
+template <typename K, typename V>
+struct HashMap {
+  HashMap() = default;
+  explicit HashMap(Allocator *allocator, u32 capacity = 0);
+  ~HashMap();
+
+  HashMap(const HashMap &) = delete;
+  HashMap &operator=(const HashMap &) = delete;
+
+  void init(Allocator *allocator, u32 capacity = 0);
+  void release();
+  void reserve(u32 new_capacity);
+
+  V *find(const K &key);
+  const V *find(const K &key) const;
+  V &operator[](const K &key);
+  bool remove(const K &key);
+  void clear();
+
+  template <typename F>
+  void forEach(F &&func);
+
+  enum SlotState : u8 { Slot_Empty, Slot_Filled, Slot_Deleted };
+
+  Allocator *allocator = nullptr;
+  K *keys = nullptr;
+  V *values = nullptr;
+  u8 *states = nullptr;
+  u32 count = 0;
+  u32 used_slots = 0; // filled + deleted
+  u32 capacity = 0;
+
+      private:
+  void rehash(u32 slots);
+  i64 findSlot(const K &key) const;
+};
+
+template <typename K, typename V>
+HashMap<K, V>::HashMap(Allocator *allocator, u32 capacity) {
+  init(allocator, capacity);
+}
+
+template <typename K, typename V>
+HashMap<K, V>::~HashMap() {
+  release();
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::init(Allocator *allocator, u32 capacity) {
+  assert(!keys && "HashMap is already initialized");
+  this->allocator = allocator;
+  if (capacity)
+    reserve(capacity);
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::release() {
+  clear();
+  if (keys) {
+    allocator->deallocate(keys);
+    allocator->deallocate(values);
+    allocator->deallocate(states);
+    keys = nullptr;
+    values = nullptr;
+    states = nullptr;
+  }
+
+  capacity = 0;
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::reserve(u32 new_capacity) {
+  u32 slots = 8;
+  while (slots * 7 < new_capacity * 10) {
+    slots <<= 1;
+  }
+
+  if (slots > capacity)
+    rehash(slots);
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::rehash(u32 slots) {
+  assert(allocator && "HashMap has no allocator");
+  K *old_keys = keys;
+  V *old_values = values;
+  u8 *old_states = states;
+  u32 old_capacity = capacity;
+
+  keys = reinterpret_cast<K *>(allocator->allocate(sizeof(K) * slots, alignof(K) < 16 ? 16 : alignof(K)));
+  values = reinterpret_cast<V *>(allocator->allocate(sizeof(V) * slots, alignof(V) < 16 ? 16 : alignof(V)));
+  states = reinterpret_cast<u8 *>(allocator->allocate(slots, 16));
+  assert(keys && values && states && "HashMap allocator is out of memory");
+
+  for (u32 i = 0; i < slots; i++) {
+    states[i] = Slot_Empty;
+  }
+
+  capacity = slots;
+  count = 0;
+  used_slots = 0;
+
+  for (u32 i = 0; i < old_capacity; i++) {
+    if (old_states[i] == Slot_Filled) {
+      u32 slot = static_cast<u32>(hashKey(old_keys[i])) & (capacity - 1);
+      while (states[slot] == Slot_Filled) {
+        slot = (slot + 1) & (capacity - 1);
+      }
+
+      new (&keys[slot]) K(std::move(old_keys[i]));
+      new (&values[slot]) V(std::move(old_values[i]));
+      states[slot] = Slot_Filled;
+      count++;
+      used_slots++;
+
+      old_keys[i].~K();
+      old_values[i].~V();
+    }
+  }
+
+  if (old_keys) {
+    allocator->deallocate(old_keys);
+    allocator->deallocate(old_values);
+    allocator->deallocate(old_states);
+  }
+}
+
+template <typename K, typename V>
+i64 HashMap<K, V>::findSlot(const K &key) const {
+  if (!capacity)
+    return -1;
+
+  u32 slot = static_cast<u32>(hashKey(key)) & (capacity - 1);
+  for (u32 probe = 0; probe < capacity; probe++) {
+    if (states[slot] == Slot_Empty)
+      return -1;
+
+    if (states[slot] == Slot_Filled && keys[slot] == key)
+      return slot;
+
+    slot = (slot + 1) & (capacity - 1);
+  }
+
+  return -1;
+}
+
+template <typename K, typename V>
+V *HashMap<K, V>::find(const K &key) {
+  i64 slot = findSlot(key);
+
+  return slot >= 0 ? &values[slot] : nullptr;
+}
+
+template <typename K, typename V>
+const V *HashMap<K, V>::find(const K &key) const {
+  i64 slot = findSlot(key);
+
+  return slot >= 0 ? &values[slot] : nullptr;
+}
+
+template <typename K, typename V>
+V &HashMap<K, V>::operator[](const K &key) {
+  if (V *value = find(key))
+    return *value;
+
+  if ((used_slots + 1) * 10 > capacity * 7) {
+    // grow when it is really filling up, otherwise only drop the tombstones
+    rehash((count + 1) * 10 > capacity * 5 ? (capacity ? capacity * 2 : 8) : capacity);
+  }
+
+  u32 slot = static_cast<u32>(hashKey(key)) & (capacity - 1);
+  while (states[slot] == Slot_Filled) {
+    slot = (slot + 1) & (capacity - 1);
+  }
+
+  if (states[slot] == Slot_Empty)
+    used_slots++;
+
+  new (&keys[slot]) K(key);
+  new (&values[slot]) V();
+  states[slot] = Slot_Filled;
+  count++;
+
+  return values[slot];
+}
+
+template <typename K, typename V>
+bool HashMap<K, V>::remove(const K &key) {
+  i64 slot = findSlot(key);
+  if (slot < 0)
+    return false;
+
+  keys[slot].~K();
+  values[slot].~V();
+  states[slot] = Slot_Deleted;
+  count--;
+
+  return true;
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::clear() {
+  for (u32 i = 0; i < capacity; i++) {
+    if (states[i] == Slot_Filled) {
+      keys[i].~K();
+      values[i].~V();
+    }
+
+    states[i] = Slot_Empty;
+  }
+
+  count = 0;
+  used_slots = 0;
+}
+
+template <typename K, typename V>
+template <typename F>
+void HashMap<K, V>::forEach(F &&func) {
+  for (u32 i = 0; i < capacity; i++) {
+    if (states[i] == Slot_Filled)
+      func(keys[i], values[i]);
+  }
+}
+
+// Fixed capacity FIFO queue. Capacity is rounded up to a power of two.
+template <typename T>
+struct RingBuffer {
+  RingBuffer() = default;
+  RingBuffer(Allocator *allocator, u32 capacity);
+  ~RingBuffer();
+
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+
+  void init(Allocator *allocator, u32 capacity);
+  void release();
+
+  bool pushBack(const T &value);
+  bool pushFront(const T &value);
+  bool popFront(T *value);
+  bool popBack(T *value);
+  void clear();
+
+  inline T &front() {
+    assert(count > 0);
+    return data[head];
+  }
+
+  inline T &operator[](u32 index) {
+    assert(index < count);
+    return data[(head + index) & (capacity - 1)];
+  }
+
+  inline bool empty() const { return count == 0; }
+  inline bool full() const { return count == capacity; }
+
+  Allocator *allocator = nullptr;
+  T *data = nullptr;
+  u32 head = 0;
+  u32 count = 0;
+  u32 capacity = 0;
+};
+
+template <typename T>
+RingBuffer<T>::RingBuffer(Allocator *allocator, u32 capacity) {
+  init(allocator, capacity);
+}
+
+template <typename T>
+RingBuffer<T>::~RingBuffer() {
+  release();
+}
+
+template <typename T>
+void RingBuffer<T>::init(Allocator *allocator, u32 capacity) {
+  assert(!data && "RingBuffer is already initialized");
+  assert(capacity > 0);
+
+  u32 slots = 1;
+  while (slots < capacity) {
+    slots <<= 1;
+  }
+
+  this->allocator = allocator;
+  this->capacity = slots;
+  data = reinterpret_cast<T *>(allocator->allocate(sizeof(T) * slots, alignof(T) < 16 ? 16 : alignof(T)));
+  assert(data && "RingBuffer allocator is out of memory");
+}
+
+template <typename T>
+void RingBuffer<T>::release() {
+  if (data) {
+    clear();
+    allocator->deallocate(data);
+    data = nullptr;
+  }
+
+  capacity = 0;
+}
+
+template <typename T>
+bool RingBuffer<T>::pushBack(const T &value) {
+  if (full())
+    return false;
+
+  new (&data[(head + count) & (capacity - 1)]) T(value);
+  count++;
+
+  return true;
+}
+
+template <typename T>
+bool RingBuffer<T>::pushFront(const T &value) {
+  if (full())
+    return false;
+
+  head = (head - 1) & (capacity - 1);
+  new (&data[head]) T(value);
+  count++;
+
+  return true;
+}
+
+template <typename T>
+bool RingBuffer<T>::popFront(T *value) {
+  if (empty())
+    return false;
+
+  if (value)
+    *value = std::move(data[head]);
+
+  data[head].~T();
+  head = (head + 1) & (capacity - 1);
+  count--;
+
+  return true;
+}
+
+template <typename T>
+bool RingBuffer<T>::popBack(T *value) {
+  if (empty())
+    return false;
+
+  u32 tail = (head + count - 1) & (capacity - 1);
+  if (value)
+    *value = std::move(data[tail]);
+
+  data[tail].~T();
+  count--;
+
+  return true;
+}
+
+template <typename T>
+void RingBuffer<T>::clear() {
+  while (popFront(nullptr)) {
+  }
+
+  head = 0;
+}
+
+#endif
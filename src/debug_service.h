@@ -1,7 +1,16 @@
 #ifndef DEBUG_SERVICE_H
 #define DEBUG_SERVICE_H
 
-enum class DebugType { BeginProfile, EndProfile, FrameMarker, MemoryUsage };
+enum class DebugType {
+  BeginProfile,
+  EndProfile,
+  FrameMarker,
+  MemoryUsage,
+  PageFaults,
+  MemoryTagUsage,
+  EventTiming,
+  EventListenerTiming
+};
 
 
 struct DebugEvent {
@@ -13,6 +22,17 @@ struct DebugEvent {
   union {
     f32 value_f32;
     u32 value_u32;
+    struct {
+      u32 used;
+      u32 high_water;
+      u32 allocations;
+      u32 frame_allocations;
+    } memory_tag;
+    struct {
+      u32 event_type;
+      u32 count;
+      u64 cycles;
+    } event_timing;
   };
 };
 
@@ -67,7 +87,29 @@ extern DebugTable g_debug_table;
 #define MEMORY_USAGE(memory)                                                                                           \
   {                                                                                                                    \
     recordDebugEvent(DebugType::MemoryUsage, DEBUG_NAME("Memory Usage"), "Memory Usage");                               \
-    event.value_u32 = memory.resource_partition->used_memory + memory.game_partition->used_memory;                     \
+    event.value_u32 = memory.resource_partition->used_memory + memory.game_partition->used_memory +                   \
+                      memory.resource_heap->used_memory;                                                               \
+    g_debug_table.push_back(event);                                                                                    \
+  }
+
+#define MEMORY_TAGS(memory)                                                                                            \
+  {                                                                                                                    \
+    for (u32 tag_index = 0; tag_index < memory_tag_count; tag_index++) {                                               \
+      ProxyAllocator *tagged_partition = memory.tagged_partitions[tag_index];                                          \
+      recordDebugEvent(DebugType::MemoryTagUsage, DEBUG_NAME("Memory Tag"), memoryTagName(tagged_partition->tag));      \
+      event.memory_tag.used = static_cast<u32>(tagged_partition->used_memory);                                         \
+      event.memory_tag.high_water = static_cast<u32>(tagged_partition->high_water);                                    \
+      event.memory_tag.allocations = static_cast<u32>(tagged_partition->num_allocations);                              \
+      event.memory_tag.frame_allocations = static_cast<u32>(tagged_partition->frame_allocations);                      \
+      g_debug_table.push_back(event);                                                                                  \
+      tagged_partition->resetFrameStats();                                                                             \
+    }                                                                                                                  \
+  }
+
+#define PAGE_FAULTS(count)                                                                                             \
+  {                                                                                                                    \
+    recordDebugEvent(DebugType::PageFaults, DEBUG_NAME("Page Faults"), "Page Faults");                                 \
+    event.value_u32 = static_cast<u32>(count);                                                                         \
     g_debug_table.push_back(event);                                                                                    \
   }
 
@@ -85,6 +127,20 @@ internal void DEBUG_PlainConsolePrint(const DebugTable &debug_table) {
       fprintf(stdout, "GUID:%s; Name:%s, Sec elapsed:%f.\n", debug_entry.GUID, debug_entry.name, debug_entry.value_f32);
     } else if (debug_entry.type == DebugType::MemoryUsage) {
       fprintf(stdout, "GUID:%s; Name:%s, Memory used: %d bytes.\n", debug_entry.GUID, debug_entry.name, debug_entry.value_u32);
+    } else if (debug_entry.type == DebugType::MemoryTagUsage) {
+      fprintf(stdout, "GUID:%s; Name:%s, Used: %u bytes, High water: %u bytes, Allocations: %u, This frame: %u.\n",
+          debug_entry.GUID, debug_entry.name, debug_entry.memory_tag.used, debug_entry.memory_tag.high_water,
+          debug_entry.memory_tag.allocations, debug_entry.memory_tag.frame_allocations);
+    } else if (debug_entry.type == DebugType::EventTiming) {
+      fprintf(stdout, "GUID:%s; Name:%s %u, Events: %u, Clock:%ukcy.\n", debug_entry.GUID, debug_entry.name,
+          debug_entry.event_timing.event_type, debug_entry.event_timing.count,
+          static_cast<u32>(debug_entry.event_timing.cycles / 1000));
+    } else if (debug_entry.type == DebugType::EventListenerTiming) {
+      fprintf(stdout, "GUID:%s; Name:%s, Event type: %u, Events: %u, Clock:%ukcy.\n", debug_entry.GUID,
+          debug_entry.name, debug_entry.event_timing.event_type, debug_entry.event_timing.count,
+          static_cast<u32>(debug_entry.event_timing.cycles / 1000));
+    } else if (debug_entry.type == DebugType::PageFaults) {
+      fprintf(stdout, "GUID:%s; Name:%s, Page faults: %d.\n", debug_entry.GUID, debug_entry.name, debug_entry.value_u32);
     } else {
       u64 end_clock = __rdtsc();
       u64 duration = end_clock - debug_entry.clock;
@@ -105,6 +161,8 @@ internal void DEBUG_PlainConsolePrint(const DebugTable &debug_table) {
 #define FRAME_MARKER(...)
 #define END_DEBUG(...)
 #define MEMORY_USAGE(...)
+#define MEMORY_TAGS(...)
+#define PAGE_FAULTS(...)
 
 #endif
 
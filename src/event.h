@@ -1,21 +1,84 @@
 #ifndef EVENT_H
 #define EVENT_H
 
+#include "event_trace.h"
+
 struct EventData;
 
-typedef u64 EventType;
 typedef std::shared_ptr<EventData> EventDataPtr;
 
 namespace {
-constexpr int32_t max_queues = 2;
 constexpr u64 infinite = 0xffffffff;
+constexpr u32 event_budget_check_interval = 16;  // events between two clock reads
+constexpr u32 event_ring_size = MB(1);
+constexpr u32 event_record_alignment = 16;
+constexpr EventType event_type_padding = 0;  // eventID never returns 0
+constexpr u32 cache_line_size = 64;
+constexpr u32 posted_event_capacity = 4096;
+constexpr u32 posted_event_payload_size = 96;
+constexpr u32 event_data_queue_capacity = 1024;
+constexpr u32 event_delegate_size = 32;  // vtable + object + pointer to member function
+constexpr u32 max_event_delegates = 1024;
+constexpr u32 invalid_listener = 0xffffffff;
+constexpr u32 timer_ticks_per_second = 1000;
+constexpr u32 timer_wheel_bits = 8;
+constexpr u32 timer_wheel_slots = 1 << timer_wheel_bits;
+constexpr u32 timer_wheel_levels = 4;  // 2^32 ticks, about 49 days at 1 ms
+constexpr u32 timer_payload_size = 80;
+constexpr u32 max_event_timers = 32768;
 }  // namespace
 
-internal u64 genEventID() {
-    local_var u64 event_id = 0;
-    assert(event_id < infinite);
+// FNV-1a of the event name. Unlike a counter bumped at static init, the id does not depend on
+// how many event types the binary has or the order they are initialized in, so the events still
+// queued in the rings, the posted queue and the timers keep their type over a code reload.
+// Changing the fields of a POD event that can be queued across a reload needs a new name.
+internal constexpr EventType eventID(const char *name) {
+    EventType hash = 0xcbf29ce484222325;
+    for (; *name; name++) {
+	hash = (hash ^ static_cast<u8>(*name)) * 0x100000001b3;
+    }
 
-    return ++event_id;
+    return hash != event_type_padding ? hash : 1;
+}
+
+namespace {
+constexpr u32 event_priority_count = static_cast<u32>(EventPriority::Count);
+}  // namespace
+
+// Deadline for one broadcast. The clock is read once every event_budget_check_interval events
+// instead of after every event.
+struct EventBudget {
+    explicit EventBudget(f32 max_ms);
+
+    inline bool spend(u32 events);
+
+    steady_clock::time_point deadline;
+    u32 until_check;
+    b32 unlimited;
+    b32 expired;
+};
+
+EventBudget::EventBudget(f32 max_ms)
+    : until_check{event_budget_check_interval}, unlimited{max_ms >= static_cast<f32>(infinite)}, expired{false} {
+    if (!unlimited) {
+	deadline = steady_clock::now() + duration_cast<steady_clock::duration>(duration<f32, std::milli>(max_ms));
+    }
+}
+
+// Returns true once the budget is used up
+inline bool EventBudget::spend(u32 events) {
+    if (unlimited || expired) {
+	return expired;
+    }
+
+    if (events >= until_check) {
+	until_check = event_budget_check_interval;
+	expired = steady_clock::now() >= deadline;
+    } else {
+	until_check -= events;
+    }
+
+    return expired;
 }
 
 struct EventData {
@@ -29,19 +92,14 @@ struct EventData {
 };
 
 struct BaseEventDelegate {
-    BaseEventDelegate(std::string id) : id{id} {}
-
     virtual void delegate(EventDataPtr event) = 0;
     virtual ~BaseEventDelegate() {}
-
-    std::string id;
 };
 
 template <typename E>
 struct EventDelegate : public BaseEventDelegate {
     typedef void (E::*fn_ptr)(EventDataPtr);
-    EventDelegate(E *event, fn_ptr func, std::string id)
-	: event{event}, func{func}, BaseEventDelegate{id} {}
+    EventDelegate(E *event, fn_ptr func) : event{event}, func{func} {}
 
     void delegate(EventDataPtr event) override;
 
@@ -54,103 +112,1054 @@ void EventDelegate<E>::delegate(EventDataPtr event_data) {
     (event->*func)(event_data);
 }
 
+/************** POD events *****
+########################################################################################################################
+  Trivially copyable events skip EventData. They are copied inline into a byte ring as
+  (type, size, payload) records and handed to listeners as const references through a plain
+  function pointer, so queueing is a memcpy and dispatch involves no refcounts or vtables.
+  An event type only needs a `static const EventType event_type` member.
+*/
+
+struct EventRecord {
+    EventType type;
+    u32 size;         // payload bytes
+    u32 record_size;  // header + payload, rounded up to event_record_alignment
+};
+
+// Single consumer byte ring. A record never wraps around the end of the buffer, the space
+// left there is taken by a padding record instead.
+struct EventRing {
+    void init(Allocator *allocator, u32 capacity);
+    void release();
+
+    bool push(EventType type, const void *payload, u32 size);
+
+    inline EventRecord *at(u64 offset) {
+	return reinterpret_cast<EventRecord *>(data + (offset & (capacity - 1)));
+    }
+    inline bool empty() const { return head == tail; }
+
+    Allocator *allocator = nullptr;
+    u8 *data = nullptr;
+    u32 capacity = 0;
+    u64 head = 0;  // offsets only grow and are masked on access
+    u64 tail = 0;
+};
+
+void EventRing::init(Allocator *allocator, u32 capacity) {
+    assert(!data && "EventRing is already initialized");
+
+    u32 size = event_record_alignment;
+    while (size < capacity) {
+	size <<= 1;
+    }
+
+    this->allocator = allocator;
+    this->capacity = size;
+    data = reinterpret_cast<u8 *>(allocator->allocate(size, event_record_alignment));
+    assert(data && "EventRing allocator is out of memory");
+    head = 0;
+    tail = 0;
+}
+
+void EventRing::release() {
+    if (data) {
+	allocator->deallocate(data);
+	data = nullptr;
+    }
+
+    capacity = 0;
+    head = 0;
+    tail = 0;
+}
+
+bool EventRing::push(EventType type, const void *payload, u32 size) {
+    u32 record_size = static_cast<u32>(memory::alignUp(sizeof(EventRecord) + size, event_record_alignment));
+    u32 offset = static_cast<u32>(tail & (capacity - 1));
+    u32 padding = offset + record_size > capacity ? capacity - offset : 0;
+    if (tail + padding + record_size - head > capacity) {
+	return false;
+    }
+
+    if (padding) {
+	EventRecord *padding_record = at(tail);
+	padding_record->type = event_type_padding;
+	padding_record->size = 0;
+	padding_record->record_size = padding;
+	tail += padding;
+    }
+
+    EventRecord *record = at(tail);
+    record->type = type;
+    record->size = size;
+    record->record_size = record_size;
+    memcpy(record + 1, payload, size);
+    tail += record_size;
+
+    return true;
+}
+
+/************** Cross-thread events *****
+########################################################################################################################
+  Bounded multi-producer single-consumer queue (Vyukov): every slot carries a sequence number
+  that tells producers and the consumer whose turn it is, so posting is one CAS on the enqueue
+  position and no locks. Slots and both positions sit on their own cache lines.
+*/
+
+struct alignas(cache_line_size) PostedEvent {
+    std::atomic<u64> sequence;
+    EventType type;
+    u32 producer;
+    u32 size;
+    EventPriority priority;
+    u8 payload[posted_event_payload_size];
+};
+
+struct PostedEventQueue {
+    void init(Allocator *allocator, u32 capacity);
+    void release();
+
+    // Any thread. Returns false when the queue is full.
+    bool post(EventType type, const void *payload, u32 size, u32 producer, EventPriority priority);
+
+    // Consumer only. Moves everything posted so far into the ring of its priority ordered by
+    // producer, in posting order within a producer, so the result does not depend on thread timing.
+    u32 drainInto(EventRing *rings, Array<u64> &scratch);
+
+    Allocator *allocator = nullptr;
+    PostedEvent *slots = nullptr;
+    u32 capacity = 0;
+
+    alignas(cache_line_size) std::atomic<u64> enqueue_position{0};
+    alignas(cache_line_size) u64 dequeue_position = 0;
+};
+
+void PostedEventQueue::init(Allocator *allocator, u32 capacity) {
+    assert(!slots && "PostedEventQueue is already initialized");
+
+    u32 size = 2;
+    while (size < capacity) {
+	size <<= 1;
+    }
+
+    this->allocator = allocator;
+    this->capacity = size;
+    slots = reinterpret_cast<PostedEvent *>(allocator->allocate(sizeof(PostedEvent) * size, cache_line_size));
+    assert(slots && "PostedEventQueue allocator is out of memory");
+    for (u32 i = 0; i < size; i++) {
+	new (&slots[i].sequence) std::atomic<u64>(i);
+    }
+
+    enqueue_position.store(0, std::memory_order_relaxed);
+    dequeue_position = 0;
+}
+
+void PostedEventQueue::release() {
+    if (slots) {
+	allocator->deallocate(slots);
+	slots = nullptr;
+    }
+
+    capacity = 0;
+}
+
+bool PostedEventQueue::post(EventType type, const void *payload, u32 size, u32 producer, EventPriority priority) {
+    assert(size <= posted_event_payload_size);
+
+    PostedEvent *slot;
+    u64 position = enqueue_position.load(std::memory_order_relaxed);
+    for (;;) {
+	slot = &slots[position & (capacity - 1)];
+	u64 sequence = slot->sequence.load(std::memory_order_acquire);
+	i64 diff = static_cast<i64>(sequence - position);
+	if (diff == 0) {
+	    if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+		break;
+	    }
+	} else if (diff < 0) {
+	    return false;  // the consumer has not freed this slot yet
+	} else {
+	    position = enqueue_position.load(std::memory_order_relaxed);
+	}
+    }
+
+    slot->type = type;
+    slot->producer = producer;
+    slot->size = size;
+    slot->priority = priority;
+    memcpy(slot->payload, payload, size);
+    slot->sequence.store(position + 1, std::memory_order_release);
+
+    return true;
+}
+
+u32 PostedEventQueue::drainInto(EventRing *rings, Array<u64> &scratch) {
+    u64 start = dequeue_position;
+    u64 end = start;
+    scratch.clear();
+    while (end - start < capacity) {
+	PostedEvent *slot = &slots[end & (capacity - 1)];
+	if (slot->sequence.load(std::memory_order_acquire) != end + 1) {
+	    break;
+	}
+	scratch.push((static_cast<u64>(slot->producer) << 32) | (end - start));
+	++end;
+    }
+
+    std::sort(scratch.begin(), scratch.end());
+
+    u32 moved = 0;
+    for (u64 key : scratch) {
+	PostedEvent *slot = &slots[(start + (key & 0xffffffff)) & (capacity - 1)];
+	if (!rings[static_cast<u32>(slot->priority)].push(slot->type, slot->payload, slot->size)) {
+	    assert(false && "Event ring is full, posted event dropped");
+	    continue;
+	}
+	++moved;
+    }
+
+    for (u64 position = start; position != end; ++position) {
+	slots[position & (capacity - 1)].sequence.store(position + capacity, std::memory_order_release);
+    }
+    dequeue_position = end;
+
+    return moved;
+}
+
+/************** Timed events *****
+########################################################################################################################
+  Events queued for later wait in a hierarchical timing wheel: timer_wheel_levels levels of
+  timer_wheel_slots lists, each level covering timer_wheel_slots times the span of the one below.
+  A timer goes into the coarsest slot that still tells its expiry apart and moves down a level
+  whenever the wheel below wraps around, so inserting and cancelling are O(1) and advancing
+  the clock only touches the lists that are due.
+*/
+
+struct TimerNode {
+    TimerNode *next;  // also the free list link while the node sits in the pool
+    TimerNode *prev;
+    u64 expires;  // tick
+    EventType type;
+    u32 size;
+    u32 generation;  // bumped whenever the node goes back to the pool
+    u16 wheel_slot;  // level * timer_wheel_slots + slot
+    EventPriority priority;
+    alignas(16) u8 payload[timer_payload_size];
+};
+
+struct TimerList {
+    TimerNode *head;
+    TimerNode *tail;
+};
+
+// Returned by queueEventAfter/queueEventAt, stays safe to cancel after the timer fired
+struct TimerHandle {
+    TimerNode *node = nullptr;
+    u32 generation = 0;
+
+    inline bool isValid() const { return node != nullptr; }
+};
+
+typedef void (*EventThunk)(void *object, const void *event);
+
+template <typename E, typename O, void (O::*fn)(const E &)>
+void eventThunk(void *object, const void *event) {
+    (static_cast<O *>(object)->*fn)(*static_cast<const E *>(event));
+}
+
+// Listener names for profiling, e.g. "... [with E = EntityDamaged; O = TestEntity; ... = &TestEntity::onDamaged]"
+template <typename E, typename O, void (O::*fn)(const E &)>
+const char *eventListenerName() {
+    return __PRETTY_FUNCTION__;
+}
+
+// Batch listeners get every queued event of their type in one call
+typedef void (*EventBatchThunk)(void *object, const void *events, u32 count);
+
+template <typename E, typename O, void (O::*fn)(const E *, u32)>
+void eventBatchThunk(void *object, const void *events, u32 count) {
+    (static_cast<O *>(object)->*fn)(static_cast<const E *>(events), count);
+}
+
+template <typename E, typename O, void (O::*fn)(const E *, u32)>
+const char *eventBatchListenerName() {
+    return __PRETTY_FUNCTION__;
+}
+
+template <typename E>
+const char *delegateListenerName() {
+    return __PRETTY_FUNCTION__;
+}
+
+// EventData listeners go through their delegate, the event is an EventDataPtr
+internal void delegateThunk(void *object, const void *event) {
+    static_cast<BaseEventDelegate *>(object)->delegate(*static_cast<const EventDataPtr *>(event));
+}
+
+// Returned by addListener. Stale handles (listener already removed) are rejected by the generation.
+struct ListenerHandle {
+    u32 index = invalid_listener;
+    u32 generation = 0;
+
+    inline bool isValid() const { return index != invalid_listener; }
+};
+
+struct EventListener {
+    void *object;
+    union {
+	EventThunk thunk;
+	EventBatchThunk batch_thunk;
+    };
+    u32 slot;    // back reference into listener_slots, fixed up on swap-remove
+    u8 removed;  // removed while a dispatch was running, erased once it finishes
+    u8 batched;
+};
+
+struct ListenerSlot {
+    EventType type;
+    u32 dense_index;  // position in event_listeners[type], next free slot when unused
+    u32 generation;
+    const char *name;
+};
+
+// Accumulated over one broadcast and reported to the debug table, see recordTimings
+struct EventTiming {
+    u64 cycles;
+    u32 count;
+};
+
+// Batched broadcast buckets the queued POD events by type, keeping queue order within a type,
+// and runs every listener over its whole bucket so handler code and data stay in cache.
+// Events of different types are then no longer delivered in queue order.
+enum class EventDispatchMode { PerEvent, Batched };
+
+struct EventBatch {
+    EventType type;
+    u32 size;   // payload bytes of one event
+    u32 count;
+    u32 first;           // into batch_order
+    u32 payload_offset;  // into batch_payloads
+};
+
 struct EventDispatcher {
-    typedef std::vector<BaseEventDelegate *> EventListenerList;
-    typedef std::map<EventType, EventListenerList> EventListenerMap;
-    typedef std::deque<EventDataPtr> EventQueue;
+    typedef HashMap<EventType, Array<EventListener>> EventListenerMap;
+    typedef RingBuffer<EventDataPtr> EventQueue;
 
+    // The dispatcher lives in game memory so queued events and timers survive a code reload,
+    // the game binds it again after every load
     static EventDispatcher *instance();
+    static void bind(EventDispatcher *dispatcher);
+
+    // allocator has to support deallocate, listener lists grow and shrink
+    void init(Allocator *allocator, u32 ring_size = event_ring_size);
+
+    // Listener thunks, delegates, listener names and EventData events point into the game code,
+    // so after a reload they are dropped and their owners have to add their listeners again.
+    // POD events, posted events and timers are plain data and stay queued.
+    void onCodeReload();
+
+    // EventData events and their reference counts live on the C++ heap, outside game memory.
+    // The platform releases them while the code that created them is still loaded, before a
+    // code reload or a snapshot restore. After a restore the queue holds the references taken
+    // with the snapshot, which are long gone, so they are dropped without being released.
+    void releaseEventData();
+    void abandonEventData();
+
+    template <typename E, typename O, void (O::*fn)(const E &)>
+    ListenerHandle addListener(O *object);
+
+    template <typename E>
+    ListenerHandle addListener(E *object, void (E::*func)(EventDataPtr), EventType type);
+
+    // Called with a span of events in batched mode, with one event otherwise
+    template <typename E, typename O, void (O::*fn)(const E *, u32)>
+    ListenerHandle addBatchListener(O *object);
+
+    // O(1), safe to call from inside a handler
+    bool removeListener(ListenerHandle handle);
+
+    template <typename E>
+    std::enable_if_t<std::is_trivially_copyable_v<E>, bool> fireEvent(const E &event);
+
+    template <typename E>
+    std::enable_if_t<std::is_trivially_copyable_v<E>, bool> queueEvent(const E &event,
+								      EventPriority priority = EventPriority::Normal);
+
+    // Thread-safe queueEvent for worker threads. producer is a stable id of the posting job
+    // (e.g. worker index) and decides the order events are delivered in.
+    template <typename E>
+    bool postEvent(const E &event, u32 producer, EventPriority priority = EventPriority::Normal);
 
+    // Timed POD events, queued with their priority once the dispatcher clock reaches them.
+    // Times are in seconds of dispatcher time, see advanceTime.
     template <typename E>
-    bool addListener(const std::string &id, E *object,
-		     void (E::*func)(EventDataPtr), EventType type);
+    TimerHandle queueEventAfter(const E &event, f32 delay, EventPriority priority = EventPriority::Normal);
+
+    template <typename E>
+    TimerHandle queueEventAt(const E &event, f32 time, EventPriority priority = EventPriority::Normal);
+
+    bool cancelTimer(TimerHandle handle);
 
-    bool removeListener(const std::string &id, EventType type);
+    // Moves the dispatcher clock forward and queues the timed events that came due
+    void advanceTime(f32 dt);
+    inline f32 time() const { return static_cast<f32>(elapsed_ticks) / timer_ticks_per_second; }
 
-    bool fireEvent(const EventDataPtr &event) const;
+    bool fireEvent(const EventDataPtr &event);
     bool queueEvent(const EventDataPtr &event);
     bool abortEvent(EventType type, bool all_types = false);
-    bool broadcast(u64 max_millis);
+
+    bool startTrace(const char *path);
+    void stopTrace();
+
+    // Delivers what was queued before the call: critical events first, then EventData events,
+    // then normal and low priority POD events until max_ms (fractions allowed) runs out.
+    // Leftovers stay queued in front of newer events. Returns true when everything was delivered.
+    bool broadcast(f32 max_ms = static_cast<f32>(infinite));
 
     EventListenerMap event_listeners;
-    EventQueue queues[max_queues];
-    i32 active_queue;
+    EventQueue queue;
+    u32 queue_pending = 0;  // EventData events the running broadcast still has to deliver
+
+    Allocator *allocator = nullptr;
+    PoolAllocator *delegate_pool = nullptr;
+    Array<ListenerSlot> listener_slots;
+    u32 first_free_slot = invalid_listener;
+    Array<u32> pending_removals;
+    u32 dispatch_depth = 0;
+
+    EventRing event_rings[event_priority_count];
+    PostedEventQueue posted_events;
+    Array<u64> posted_order;
+
+    PoolAllocator *timer_pool = nullptr;
+    TimerList timer_wheel[timer_wheel_levels * timer_wheel_slots] = {};
+    u64 elapsed_ticks = 0;
+    u64 wheel_tick = 1;  // next tick the wheel processes
+    f32 tick_remainder = 0.0f;
+
+    FILE *trace_file = nullptr;
+
+#ifdef FIREWOOD_INTERNAL
+    HashMap<EventType, EventTiming> type_timings;
+    Array<EventTiming> listener_timings;  // indexed like listener_slots
+#endif
+
+    EventDispatchMode dispatch_mode = EventDispatchMode::PerEvent;
+    HashMap<EventType, u32> batch_index;
+    Array<EventBatch> batches;
+    Array<u64> batch_order;  // ring offsets grouped by batch
+    Array<u8> batch_payloads;
 
    private:
     ~EventDispatcher() {}
+
+    ListenerHandle registerListener(EventType type, void *object, EventThunk thunk, EventBatchThunk batch_thunk,
+				    const char *name);
+    void eraseListener(u32 slot_index);
+    inline void traceEvent(EventTraceKind kind, EventType type, EventPriority priority, const void *payload, u32 size);
+    void traceRing(EventTraceKind kind, EventRing &ring, u64 from, EventPriority priority);
+    void recordTimings(b32 out_of_time);
+    TimerHandle addTimer(u64 expires, EventType type, const void *payload, u32 size, EventPriority priority);
+    void insertTimer(TimerNode *node);
+    void unlinkTimer(TimerNode *node);
+    void freeTimer(TimerNode *node);
+    u32 cascadeTimers(u32 level);
+    bool dispatch(EventType type, const void *events, u32 count = 1, u32 stride = 0);
+    void dispatchRing(EventRing &ring, u64 ring_end, EventPriority priority, EventBudget *budget);
+    void dispatchBatched(EventRing &ring, u64 ring_end, EventPriority priority, EventBudget *budget);
 };
 
+global_var EventDispatcher *bound_event_dispatcher = nullptr;
+
 EventDispatcher *EventDispatcher::instance() {
-    local_var EventDispatcher *instance = new EventDispatcher();
+    assert(bound_event_dispatcher && "EventDispatcher::bind was not called");
+
+    return bound_event_dispatcher;
+}
+
+void EventDispatcher::bind(EventDispatcher *dispatcher) { bound_event_dispatcher = dispatcher; }
+
+void EventDispatcher::init(Allocator *allocator, u32 ring_size) {
+    this->allocator = allocator;
+    event_listeners.init(allocator);
+    listener_slots.init(allocator);
+    pending_removals.init(allocator);
+
+    void *delegate_memory = allocator->allocate(event_delegate_size * max_event_delegates, alignof(void *));
+    delegate_pool = alloc<PoolAllocator>(
+	allocator, event_delegate_size, alignof(void *), event_delegate_size * max_event_delegates, delegate_memory);
+
+    void *timer_memory = allocator->allocate(sizeof(TimerNode) * max_event_timers, alignof(TimerNode));
+    assert(timer_memory && "Not enough memory for event timers");
+    memset(timer_memory, 0, sizeof(TimerNode) * max_event_timers);
+    timer_pool = alloc<PoolAllocator>(
+	allocator, sizeof(TimerNode), alignof(TimerNode), sizeof(TimerNode) * max_event_timers, timer_memory);
+
+    for (EventRing &ring : event_rings) {
+	ring.init(allocator, ring_size);
+    }
+    queue.init(allocator, event_data_queue_capacity);
+    posted_events.init(allocator, posted_event_capacity);
+    posted_order.init(allocator, posted_event_capacity);
+    batch_index.init(allocator);
+    batches.init(allocator);
+    batch_order.init(allocator);
+    batch_payloads.init(allocator);
+
+#ifdef FIREWOOD_INTERNAL
+    type_timings.init(allocator);
+    listener_timings.init(allocator);
+#endif
+}
+
+void EventDispatcher::onCodeReload() {
+    assert(dispatch_depth == 0);
+
+    // Handles held by the old code stay dead: every live slot gets a new generation
+    for (u32 i = 0; i < listener_slots.count; i++) {
+	ListenerSlot &slot = listener_slots[i];
+	if (slot.type != event_type_padding) {
+	    slot.generation = slot.generation + 1 ? slot.generation + 1 : 1;
+	    slot.type = event_type_padding;
+	    slot.dense_index = first_free_slot;
+	    slot.name = nullptr;
+	    first_free_slot = i;
+	}
+    }
+    event_listeners.forEach([](EventType, Array<EventListener> &listeners) { listeners.clear(); });
+    pending_removals.clear();
+
+    // The delegates' destructors were unloaded with the old code, their slots are just reclaimed
+    delegate_pool->clear();
+
+    // Releasing EventData events would call into the old code, the platform did it before the unload
+    assert(queue.empty() && "EventData events have to be released before the code is unloaded");
+
+#ifdef FIREWOOD_INTERNAL
+    for (u32 i = 0; i < listener_timings.count; i++) {
+	listener_timings[i] = {0, 0};
+    }
+#endif
+}
+
+void EventDispatcher::releaseEventData() {
+    assert(dispatch_depth == 0);
+
+    queue.clear();
+    queue_pending = 0;
+}
+
+void EventDispatcher::abandonEventData() {
+    assert(dispatch_depth == 0);
+
+    queue.head = 0;
+    queue.count = 0;
+    queue_pending = 0;
+}
+
+ListenerHandle EventDispatcher::registerListener(EventType type, void *object, EventThunk thunk,
+						EventBatchThunk batch_thunk, const char *name) {
+    assert(allocator && "EventDispatcher::init was not called");
+
+    u32 slot_index = first_free_slot;
+    if (slot_index != invalid_listener) {
+	first_free_slot = listener_slots[slot_index].dense_index;
+    } else {
+	slot_index = listener_slots.count;
+	listener_slots.push({event_type_padding, 0, 1, nullptr});
+#ifdef FIREWOOD_INTERNAL
+	listener_timings.push({0, 0});
+#endif
+    }
 
-    return instance;
+    Array<EventListener> &listeners = event_listeners[type];
+    if (!listeners.allocator) {
+	listeners.init(allocator);
+    }
+
+    ListenerSlot &slot = listener_slots[slot_index];
+    slot.type = type;
+    slot.dense_index = listeners.count;
+    slot.name = name;
+
+    EventListener listener = {};
+    listener.object = object;
+    if (batch_thunk) {
+	listener.batch_thunk = batch_thunk;
+	listener.batched = true;
+    } else {
+	listener.thunk = thunk;
+    }
+    listener.slot = slot_index;
+    listeners.push(listener);
+
+    return {slot_index, slot.generation};
+}
+
+template <typename E, typename O, void (O::*fn)(const E &)>
+ListenerHandle EventDispatcher::addListener(O *object) {
+    static_assert(std::is_trivially_copyable_v<E>, "POD listeners take trivially copyable events");
+
+    return registerListener(E::event_type, object, &eventThunk<E, O, fn>, nullptr, eventListenerName<E, O, fn>());
+}
+
+template <typename E, typename O, void (O::*fn)(const E *, u32)>
+ListenerHandle EventDispatcher::addBatchListener(O *object) {
+    static_assert(std::is_trivially_copyable_v<E>, "POD listeners take trivially copyable events");
+
+    return registerListener(E::event_type, object, nullptr, &eventBatchThunk<E, O, fn>,
+			    eventBatchListenerName<E, O, fn>());
 }
 
 template <typename E>
-bool EventDispatcher::addListener(const std::string &id, E *object,
-				  void (E::*func)(EventDataPtr),
-				  EventType type) {
-    BaseEventDelegate *event_delegate = new EventDelegate<E>(object, func, id);
-    event_listeners[type].push_back(event_delegate);
+ListenerHandle EventDispatcher::addListener(E *object, void (E::*func)(EventDataPtr), EventType type) {
+    static_assert(sizeof(EventDelegate<E>) <= event_delegate_size, "EventDelegate does not fit the delegate pool");
+    assert(delegate_pool && "EventDispatcher::init was not called");
+
+    BaseEventDelegate *event_delegate = alloc<EventDelegate<E>>(delegate_pool, object, func);
+    assert(event_delegate && "Delegate pool is full");
+
+    return registerListener(type, event_delegate, &delegateThunk, nullptr, delegateListenerName<E>());
+}
+
+bool EventDispatcher::removeListener(ListenerHandle handle) {
+    if (handle.index >= listener_slots.count) {
+	return false;
+    }
+
+    ListenerSlot &slot = listener_slots[handle.index];
+    if (slot.generation != handle.generation || slot.type == event_type_padding) {
+	return false;
+    }
+
+    // Bumped right away so the handle is dead even if erasing has to wait
+    slot.generation = slot.generation + 1 ? slot.generation + 1 : 1;
+    if (dispatch_depth > 0) {
+	(*event_listeners.find(slot.type))[slot.dense_index].removed = true;
+	pending_removals.push(handle.index);
+    } else {
+	eraseListener(handle.index);
+    }
 
     return true;
 }
 
-bool EventDispatcher::removeListener(const std::string &id, EventType type) {
-    if (auto it = event_listeners.find(type); it != event_listeners.end()) {
-	EventListenerList &listeners = it->second;
-	for (auto it = listeners.begin(); it != listeners.end(); ++it) {
-	    // TODO: better way to remove listener ???
-	    if (id == (**it).id) {
-		it = listeners.erase(it);
-		return true;
+void EventDispatcher::eraseListener(u32 slot_index) {
+    ListenerSlot &slot = listener_slots[slot_index];
+    Array<EventListener> &listeners = *event_listeners.find(slot.type);
+
+    EventListener &listener = listeners[slot.dense_index];
+    if (!listener.batched && listener.thunk == &delegateThunk) {
+	dealloc(delegate_pool, static_cast<BaseEventDelegate *>(listener.object));
+    }
+
+    u32 last = listeners.count - 1;
+    if (slot.dense_index != last) {
+	listener_slots[listeners[last].slot].dense_index = slot.dense_index;
+    }
+    listeners.swapRemove(slot.dense_index);
+
+    slot.type = event_type_padding;
+    slot.dense_index = first_free_slot;
+    first_free_slot = slot_index;
+}
+
+// events holds count events, stride bytes apart
+bool EventDispatcher::dispatch(EventType type, const void *events, u32 count, u32 stride) {
+    Array<EventListener> *listeners = event_listeners.find(type);
+    if (!listeners || listeners->empty()) {
+	return false;
+    }
+
+    // A handler may register a listener for a new type, which moves the lists
+    u32 map_capacity = event_listeners.capacity;
+    auto refresh = [&]() {
+	if (event_listeners.capacity != map_capacity) {
+	    listeners = event_listeners.find(type);
+	    map_capacity = event_listeners.capacity;
+	}
+    };
+
+#ifdef FIREWOOD_INTERNAL
+    u64 dispatch_start = __rdtsc();
+#endif
+
+    ++dispatch_depth;
+    for (u32 i = 0; i < listeners->count; i++) {
+	// Copied, the list can grow while the handler runs
+	EventListener listener = (*listeners)[i];
+	if (listener.removed) {
+	    continue;
+	}
+
+#ifdef FIREWOOD_INTERNAL
+	u64 listener_start = __rdtsc();
+#endif
+	u32 delivered = count;
+	if (listener.batched) {
+	    listener.batch_thunk(listener.object, events, count);
+	    refresh();
+	} else {
+	    const u8 *event = static_cast<const u8 *>(events);
+	    for (u32 e = 0; e < count; e++, event += stride) {
+		listener.thunk(listener.object, event);
+		refresh();
+		if ((*listeners)[i].removed) {
+		    delivered = e + 1;
+		    break;
+		}
 	    }
 	}
+
+#ifdef FIREWOOD_INTERNAL
+	EventTiming &listener_timing = listener_timings[listener.slot];
+	listener_timing.cycles += __rdtsc() - listener_start;
+	listener_timing.count += delivered;
+#endif
+    }
+    --dispatch_depth;
+
+#ifdef FIREWOOD_INTERNAL
+    EventTiming &type_timing = type_timings[type];
+    type_timing.cycles += __rdtsc() - dispatch_start;
+    type_timing.count += count;
+#endif
+
+    if (dispatch_depth == 0 && !pending_removals.empty()) {
+	for (u32 slot_index : pending_removals) {
+	    eraseListener(slot_index);
+	}
+	pending_removals.clear();
+    }
+
+    return true;
+}
+
+void EventDispatcher::dispatchRing(EventRing &ring, u64 ring_end, EventPriority priority, EventBudget *budget) {
+    if (dispatch_mode == EventDispatchMode::Batched) {
+	dispatchBatched(ring, ring_end, priority, budget);
+	return;
     }
 
-    return false;
+    while (ring.head != ring_end && !(budget && budget->expired)) {
+	EventRecord *record = ring.at(ring.head);
+	if (record->type != event_type_padding) {
+	    traceEvent(EventTraceKind::Delivered, record->type, priority, nullptr, 0);
+	    dispatch(record->type, record + 1);
+	    if (budget) {
+		budget->spend(1);
+	    }
+	}
+
+	// The payload stays in place while listeners run, the slot is given back afterwards
+	ring.head += record->record_size;
+    }
 }
 
-bool EventDispatcher::fireEvent(const EventDataPtr &event) const {
-    bool processed = false;
-    auto it = event_listeners.find(event->getEventType());
-    if (it != event_listeners.end()) {
-	const EventListenerList &listeners = it->second;
-	for (auto it = listeners.begin(); it != listeners.end(); ++it) {
-	    BaseEventDelegate *listener = *it;
-	    listener->delegate(event);
-	    processed = true;
+// Stable counting sort of the records in [head, ring_end) by type, two passes over the ring
+void EventDispatcher::dispatchBatched(EventRing &ring, u64 ring_end, EventPriority priority, EventBudget *budget) {
+    batch_index.clear();
+    batches.clear();
+
+    EventType last_type = event_type_padding;
+    u32 batch = 0;
+    u32 total = 0;
+    for (u64 offset = ring.head; offset != ring_end; offset += ring.at(offset)->record_size) {
+	EventRecord *record = ring.at(offset);
+	if (record->type == event_type_padding) {
+	    continue;
+	}
+
+	if (record->type != last_type) {
+	    u32 *index = batch_index.find(record->type);
+	    if (!index) {
+		index = &batch_index[record->type];
+		*index = batches.count;
+		batches.push({record->type, record->size, 0, 0, 0});
+	    }
+	    batch = *index;
+	    last_type = record->type;
+	}
+	++batches[batch].count;
+	++total;
+    }
+
+    u32 payload_bytes = 0;
+    u32 first = 0;
+    for (EventBatch &event_batch : batches) {
+	event_batch.first = first;
+	event_batch.payload_offset = payload_bytes;
+	first += event_batch.count;
+	payload_bytes += event_batch.count * event_batch.size;
+	event_batch.count = 0;
+    }
+
+    // Payloads are packed per type so batch listeners get a plain const E * span
+    batch_order.resize(total);
+    batch_payloads.resize(payload_bytes);
+    last_type = event_type_padding;
+    u8 *payloads = batch_payloads.data;
+    for (u64 offset = ring.head; offset != ring_end; offset += ring.at(offset)->record_size) {
+	EventRecord *record = ring.at(offset);
+	if (record->type == event_type_padding) {
+	    continue;
+	}
+
+	if (record->type != last_type) {
+	    batch = *batch_index.find(record->type);
+	    last_type = record->type;
+	}
+	EventBatch &event_batch = batches[batch];
+	batch_order[event_batch.first + event_batch.count] = offset;
+	memcpy(payloads + event_batch.payload_offset + event_batch.count * event_batch.size, record + 1,
+	       event_batch.size);
+	++event_batch.count;
+    }
+
+    for (const EventBatch &event_batch : batches) {
+	if (budget && budget->expired) {
+	    break;
+	}
+
+	if (trace_file) {
+	    for (u32 i = 0; i < event_batch.count; i++) {
+		traceEvent(EventTraceKind::Delivered, event_batch.type, priority, nullptr, 0);
+	    }
+	}
+	dispatch(event_batch.type, payloads + event_batch.payload_offset, event_batch.count, event_batch.size);
+
+	// Delivered records become padding, so stopping early leaves only the rest in the ring
+	for (u32 i = event_batch.first; i < event_batch.first + event_batch.count; i++) {
+	    ring.at(batch_order[i])->type = event_type_padding;
+	}
+
+	// A whole batch counts as a check point
+	if (budget) {
+	    budget->spend(event_budget_check_interval);
 	}
     }
 
-    return processed;
+    while (ring.head != ring_end && ring.at(ring.head)->type == event_type_padding) {
+	ring.head += ring.at(ring.head)->record_size;
+    }
 }
 
-bool EventDispatcher::queueEvent(const EventDataPtr &event) {
-    assert(active_queue >= 0);
-    assert(active_queue < max_queues);
+template <typename E>
+std::enable_if_t<std::is_trivially_copyable_v<E>, bool> EventDispatcher::fireEvent(const E &event) {
+    traceEvent(EventTraceKind::Fired, E::event_type, EventPriority::Critical, &event, sizeof(E));
+    return dispatch(E::event_type, &event);
+}
 
-    if (auto it = event_listeners.find(event->getEventType());
-	it != event_listeners.end()) {
-	queues[active_queue].push_back(event);
+template <typename E>
+std::enable_if_t<std::is_trivially_copyable_v<E>, bool> EventDispatcher::queueEvent(const E &event,
+										   EventPriority priority) {
+    static_assert(alignof(E) <= event_record_alignment, "Event is over-aligned for the event ring");
 
-	return true;
+    const Array<EventListener> *listeners = event_listeners.find(E::event_type);
+    if (!listeners || listeners->empty()) {
+	return false;
     }
 
-    return false;
+    bool queued = event_rings[static_cast<u32>(priority)].push(E::event_type, &event, sizeof(E));
+    assert(queued && "Event ring is full");
+    traceEvent(EventTraceKind::Queued, E::event_type, priority, &event, sizeof(E));
+
+    return queued;
 }
 
-bool EventDispatcher::abortEvent(EventType type, bool all_types) {
-    assert(active_queue >= 0);
-    assert(active_queue < max_queues);
+template <typename E>
+bool EventDispatcher::postEvent(const E &event, u32 producer, EventPriority priority) {
+    static_assert(std::is_trivially_copyable_v<E>, "Posted events must be trivially copyable");
+    static_assert(sizeof(E) <= posted_event_payload_size, "Event does not fit a posted event slot");
+
+    return posted_events.post(E::event_type, &event, sizeof(E), producer, priority);
+}
+
+template <typename E>
+TimerHandle EventDispatcher::queueEventAfter(const E &event, f32 delay, EventPriority priority) {
+    static_assert(std::is_trivially_copyable_v<E>, "Timed events must be trivially copyable");
+    static_assert(sizeof(E) <= timer_payload_size, "Event does not fit a timer node");
+
+    u64 delay_ticks = delay > 0.0f ? static_cast<u64>(delay * timer_ticks_per_second + 0.5f) : 0;
+    return addTimer(elapsed_ticks + delay_ticks, E::event_type, &event, sizeof(E), priority);
+}
+
+template <typename E>
+TimerHandle EventDispatcher::queueEventAt(const E &event, f32 time, EventPriority priority) {
+    static_assert(std::is_trivially_copyable_v<E>, "Timed events must be trivially copyable");
+    static_assert(sizeof(E) <= timer_payload_size, "Event does not fit a timer node");
+
+    u64 expires = time > 0.0f ? static_cast<u64>(time * timer_ticks_per_second + 0.5f) : 0;
+    return addTimer(expires, E::event_type, &event, sizeof(E), priority);
+}
+
+TimerHandle EventDispatcher::addTimer(u64 expires, EventType type, const void *payload, u32 size,
+				      EventPriority priority) {
+    assert(timer_pool && "EventDispatcher::init was not called");
+
+    TimerNode *node = reinterpret_cast<TimerNode *>(timer_pool->allocate(sizeof(TimerNode), alignof(TimerNode)));
+    if (!node) {
+	assert(false && "Out of event timers");
+	return {};
+    }
+
+    // Anything already due fires on the next advanceTime
+    node->expires = expires < wheel_tick ? wheel_tick : expires;
+    node->type = type;
+    node->size = size;
+    node->priority = priority;
+    memcpy(node->payload, payload, size);
+    insertTimer(node);
+    traceEvent(EventTraceKind::Timed, type, priority, payload, size);
+
+    return {node, node->generation};
+}
+
+void EventDispatcher::insertTimer(TimerNode *node) {
+    u64 delta = node->expires - wheel_tick;
+    u32 level = 0;
+    while (level < timer_wheel_levels - 1 && delta >= (1ull << (timer_wheel_bits * (level + 1)))) {
+	++level;
+    }
+
+    // Past the last level the timer waits in the last level and gets re-sorted when it comes around
+    u32 slot = static_cast<u32>(node->expires >> (timer_wheel_bits * level)) & (timer_wheel_slots - 1);
+    node->wheel_slot = static_cast<u16>(level * timer_wheel_slots + slot);
+
+    TimerList &list = timer_wheel[node->wheel_slot];
+    node->next = nullptr;
+    node->prev = list.tail;
+    if (list.tail) {
+	list.tail->next = node;
+    } else {
+	list.head = node;
+    }
+    list.tail = node;
+}
+
+void EventDispatcher::unlinkTimer(TimerNode *node) {
+    TimerList &list = timer_wheel[node->wheel_slot];
+    if (node->prev) {
+	node->prev->next = node->next;
+    } else {
+	list.head = node->next;
+    }
+
+    if (node->next) {
+	node->next->prev = node->prev;
+    } else {
+	list.tail = node->prev;
+    }
+}
+
+void EventDispatcher::freeTimer(TimerNode *node) {
+    ++node->generation;
+    timer_pool->deallocate(node);
+}
+
+bool EventDispatcher::cancelTimer(TimerHandle handle) {
+    if (!handle.node || handle.node->generation != handle.generation) {
+	return false;
+    }
+
+    unlinkTimer(handle.node);
+    freeTimer(handle.node);
+
+    return true;
+}
+
+// Re-sorts the timers of the current slot of a level into the levels below, returns that slot
+u32 EventDispatcher::cascadeTimers(u32 level) {
+    u32 slot = static_cast<u32>(wheel_tick >> (timer_wheel_bits * level)) & (timer_wheel_slots - 1);
+    TimerList &list = timer_wheel[level * timer_wheel_slots + slot];
+    TimerNode *node = list.head;
+    list = {};
+    while (node) {
+	TimerNode *next = node->next;
+	insertTimer(node);
+	node = next;
+    }
+
+    return slot;
+}
+
+void EventDispatcher::advanceTime(f32 dt) {
+    tick_remainder += dt * timer_ticks_per_second;
+    u64 ticks = static_cast<u64>(tick_remainder);
+    tick_remainder -= static_cast<f32>(ticks);
+    elapsed_ticks += ticks;
+
+    while (wheel_tick <= elapsed_ticks) {
+	u32 slot = static_cast<u32>(wheel_tick) & (timer_wheel_slots - 1);
+	for (u32 level = 1; slot == 0 && level < timer_wheel_levels; level++) {
+	    slot = cascadeTimers(level);
+	}
+
+	TimerList &list = timer_wheel[static_cast<u32>(wheel_tick) & (timer_wheel_slots - 1)];
+	TimerNode *node = list.head;
+	list = {};
+	while (node) {
+	    TimerNode *next = node->next;
+	    if (node->expires <= wheel_tick) {
+		bool queued = event_rings[static_cast<u32>(node->priority)].push(node->type, node->payload, node->size);
+		assert(queued && "Event ring is full, timed event dropped");
+		freeTimer(node);
+	    } else {
+		insertTimer(node);  // beyond the range of the last level, not due yet
+	    }
+	    node = next;
+	}
+
+	++wheel_tick;
+    }
+}
+
+bool EventDispatcher::fireEvent(const EventDataPtr &event) {
+    traceEvent(EventTraceKind::Fired, event->getEventType(), EventPriority::Critical, nullptr, 0);
+    return dispatch(event->getEventType(), &event);
+}
 
+bool EventDispatcher::queueEvent(const EventDataPtr &event) {
+    const Array<EventListener> *listeners = event_listeners.find(event->getEventType());
+    if (!listeners || listeners->empty()) {
+	return false;
+    }
+
+    bool queued = queue.pushBack(event);
+    assert(queued && "EventData queue is full");
+    traceEvent(EventTraceKind::Queued, event->getEventType(), EventPriority::Normal, nullptr, 0);
+
+    return queued;
+}
+
+bool EventDispatcher::abortEvent(EventType type, bool all_types) {
     bool result = false;
-    if (auto it = event_listeners.find(type); it != event_listeners.end()) {
-	EventQueue &event_queue = queues[active_queue];
-	auto queue_it = event_queue.begin();
-	while (queue_it != event_queue.end()) {
-	    if ((*queue_it)->getEventType() == type) {
-		queue_it = event_queue.erase(queue_it);
+    if (event_listeners.find(type)) {
+	// Every event is rotated through the queue once, the aborted ones are not pushed back
+	u32 count = queue.count;
+	u32 pending = queue_pending;
+	for (u32 i = 0; i < count; i++) {
+	    EventDataPtr event;
+	    queue.popFront(&event);
+	    if ((all_types || !result) && event->getEventType() == type) {
+		if (i < pending) {
+		    --queue_pending;
+		}
+		result = true;
+	    } else {
+		queue.pushBack(event);
+	    }
+	}
+	if (result && !all_types) return result;
+    }
+
+    // Queued POD records are turned into padding in place
+    for (EventRing &ring : event_rings) {
+	for (u64 offset = ring.head; offset != ring.tail;) {
+	    EventRecord *record = ring.at(offset);
+	    offset += record->record_size;
+	    if (record->type == type) {
+		record->type = event_type_padding;
 		result = true;
 		if (!all_types) return result;
 	    }
@@ -160,49 +1169,196 @@ bool EventDispatcher::abortEvent(EventType type, bool all_types) {
     return result;
 }
 
-bool EventDispatcher::broadcast(u64 max_ms) {
-    milliseconds ms =
-	duration_cast<milliseconds>(system_clock::now().time_since_epoch());
-    u64 current_ms = ms.count();
-    u64 max_ms_limit = max_ms == infinite ? infinite : current_ms + max_ms;
+bool EventDispatcher::broadcast(f32 max_ms) {
+    EventBudget budget(max_ms);
 
-    int queue_to_process = active_queue;
-    active_queue = (active_queue + 1) % max_queues;
-    queues[active_queue].clear();
+    // Events posted by other threads go behind the ones queued on this thread. Only what is
+    // queued at this point is delivered, events queued by listeners wait for the next broadcast,
+    // so leftovers need no moving: they simply stay at the front of their queue.
+    u64 ring_ends[event_priority_count];
+    for (u32 i = 0; i < event_priority_count; i++) {
+	ring_ends[i] = event_rings[i].tail;
+    }
+    posted_events.drainInto(event_rings, posted_order);
+    if (trace_file) {
+	for (u32 i = 0; i < event_priority_count; i++) {
+	    traceRing(EventTraceKind::Posted, event_rings[i], ring_ends[i], static_cast<EventPriority>(i));
+	}
+    }
 
-    while (!queues[queue_to_process].empty()) {
-	EventDataPtr event = queues[queue_to_process].front();
-	queues[queue_to_process].pop_front();
-	EventType type = event->getEventType();
+    for (u32 i = 0; i < event_priority_count; i++) {
+	ring_ends[i] = event_rings[i].tail;
+    }
+    queue_pending = queue.count;
 
-	auto it = event_listeners.find(type);
-	if (it != event_listeners.end()) {
-	    const EventListenerList &listeners = it->second;
-	    for (auto it = listeners.begin(); it != listeners.end(); ++it) {
-		BaseEventDelegate *listener = *it;
-		listener->delegate(event);
-	    }
-	}
+    dispatchRing(event_rings[static_cast<u32>(EventPriority::Critical)],
+		 ring_ends[static_cast<u32>(EventPriority::Critical)], EventPriority::Critical, nullptr);
 
-	milliseconds elapsed_ms =
-	    duration_cast<milliseconds>(system_clock::now().time_since_epoch());
-	current_ms = elapsed_ms.count();
-	if (max_ms != infinite && current_ms >= max_ms_limit) {
-	    fprintf(stderr, "Aborting event processing. Time ran out\n");
-	    break;
+    while (queue_pending > 0 && !budget.expired) {
+	EventDataPtr event;
+	queue.popFront(&event);
+	--queue_pending;
+	traceEvent(EventTraceKind::Delivered, event->getEventType(), EventPriority::Normal, nullptr, 0);
+	dispatch(event->getEventType(), &event);
+	budget.spend(1);
+    }
+
+    for (u32 i = static_cast<u32>(EventPriority::Normal); i < event_priority_count; i++) {
+	dispatchRing(event_rings[i], ring_ends[i], static_cast<EventPriority>(i), &budget);
+    }
+
+    bool flushed = queue_pending == 0;
+    for (u32 i = 0; i < event_priority_count; i++) {
+	flushed &= event_rings[i].head == ring_ends[i];
+    }
+    queue_pending = 0;
+
+    recordTimings(!flushed);
+
+    return flushed;
+}
+
+void EventDispatcher::traceEvent(EventTraceKind kind, EventType type, EventPriority priority, const void *payload,
+				 u32 size) {
+    if (!trace_file) {
+	return;
+    }
+
+    EventTraceRecord record = {__rdtsc(), type, size, kind, priority, 0};
+    fwrite(&record, sizeof(record), 1, trace_file);
+    if (size) {
+	fwrite(payload, size, 1, trace_file);
+    }
+}
+
+void EventDispatcher::traceRing(EventTraceKind kind, EventRing &ring, u64 from, EventPriority priority) {
+    for (u64 offset = from; offset != ring.tail; offset += ring.at(offset)->record_size) {
+	EventRecord *record = ring.at(offset);
+	if (record->type != event_type_padding) {
+	    traceEvent(kind, record->type, priority, record + 1, record->size);
 	}
     }
+}
+
+bool EventDispatcher::startTrace(const char *path) {
+    stopTrace();
+    trace_file = fopen(path, "wb");
+    if (!trace_file) {
+	fprintf(stderr, "Cannot open event trace %s\n", path);
+	return false;
+    }
+
+    setvbuf(trace_file, nullptr, _IOFBF, KB(64));
+    EventTraceHeader header = {event_trace_magic, event_trace_version};
+    fwrite(&header, sizeof(header), 1, trace_file);
+
+    return true;
+}
+
+void EventDispatcher::stopTrace() {
+    if (trace_file) {
+	fclose(trace_file);
+	trace_file = nullptr;
+    }
+}
+
+// Reports what this broadcast (and fireEvent calls since the last one) spent per event type
+// and per listener, then starts over
+void EventDispatcher::recordTimings(b32 out_of_time) {
+#ifdef FIREWOOD_INTERNAL
+    type_timings.forEach([](EventType type, EventTiming &timing) {
+	if (timing.count) {
+	    recordDebugEvent(DebugType::EventTiming, DEBUG_NAME("Event Type"), "Event Type");
+	    event.event_timing.event_type = static_cast<u32>(type);
+	    event.event_timing.count = timing.count;
+	    event.event_timing.cycles = timing.cycles;
+	    g_debug_table.push_back(event);
+	}
+	timing = {0, 0};
+    });
+
+    u32 slowest = invalid_listener;
+    for (u32 i = 0; i < listener_timings.count; i++) {
+	EventTiming &timing = listener_timings[i];
+	if (!timing.count) {
+	    continue;
+	}
+
+	recordDebugEvent(DebugType::EventListenerTiming, DEBUG_NAME("Event Listener"), listener_slots[i].name);
+	event.event_timing.event_type = static_cast<u32>(listener_slots[i].type);
+	event.event_timing.count = timing.count;
+	event.event_timing.cycles = timing.cycles;
+	g_debug_table.push_back(event);
 
-    bool queue_flushed = queues[queue_to_process].empty();
-    if (!queue_flushed) {
-	while (!queues[queue_to_process].empty()) {
-	    EventDataPtr event = queues[queue_to_process].back();
-	    queues[queue_to_process].pop_back();
-	    queues[active_queue].push_front(event);
+	if (slowest == invalid_listener || timing.cycles > listener_timings[slowest].cycles) {
+	    slowest = i;
 	}
     }
 
-    return queue_flushed;
+    if (out_of_time && slowest != invalid_listener) {
+	fprintf(stderr, "Aborting event processing. Time ran out, slowest listener: %s (%u events, %lu cycles)\n",
+		listener_slots[slowest].name, listener_timings[slowest].count,
+		static_cast<unsigned long>(listener_timings[slowest].cycles));
+    } else if (out_of_time) {
+	fprintf(stderr, "Aborting event processing. Time ran out\n");
+    }
+
+    for (EventTiming &timing : listener_timings) {
+	timing = {0, 0};
+    }
+#else
+    if (out_of_time) {
+	fprintf(stderr, "Aborting event processing. Time ran out\n");
+    }
+#endif
 }
 
+/************** Static event bus *****
+########################################################################################################################
+  For code that is compiled together (not across the hot-reload boundary) the set of handlers
+  and the events they take are known up front. StaticEventBus<Handlers...> delivers an event to
+  every handler with a matching onEvent(const E &) through direct calls the compiler can inline:
+  no listener lists, thunks or payload copies. connect<E> bridges the dynamic dispatcher into a
+  bus, so queued, posted and timed events still reach static handlers.
+*/
+
+template <typename H, typename E, typename = void>
+struct HandlesEvent : std::false_type {};
+
+template <typename H, typename E>
+struct HandlesEvent<H, E, std::void_t<decltype(std::declval<H &>().onEvent(std::declval<const E &>()))>>
+    : std::true_type {};
+
+template <typename... Handlers>
+struct StaticEventBus {
+    explicit StaticEventBus(Handlers *...handlers) : handlers{handlers...} {}
+
+    template <typename E>
+    static constexpr bool handles() {
+	return (HandlesEvent<Handlers, E>::value || ...);
+    }
+
+    // Handlers are called in the order of the template arguments
+    template <typename E>
+    void fire(const E &event) {
+	static_assert(handles<E>(), "No handler of this bus takes the event");
+	(deliver<Handlers>(event), ...);
+    }
+
+    template <typename E>
+    ListenerHandle connect(EventDispatcher *dispatcher) {
+	return dispatcher->addListener<E, StaticEventBus, &StaticEventBus::fire<E>>(this);
+    }
+
+    std::tuple<Handlers *...> handlers;
+
+   private:
+    template <typename H, typename E>
+    inline void deliver(const E &event) {
+	if constexpr (HandlesEvent<H, E>::value) {
+	    std::get<H *>(handlers)->onEvent(event);
+	}
+    }
+};
+
 #endif
@@ -0,0 +1,126 @@
+#include "os_platform.h"
+
+// Times one broadcast of 10k and 100k queued POD events spread over a few event types, once
+// delivered per event in queue order and once batched by type. Every type has a per-event
+// listener and a batch listener. Prints microseconds per broadcast.
+
+#ifdef FIREWOOD_INTERNAL
+DebugTable g_debug_table;
+#endif
+
+namespace {
+constexpr u32 bench_event_types = 4;
+constexpr u32 bench_ring_size = MB(8);
+constexpr const char *bench_event_names[bench_event_types] = {"BenchEvent0", "BenchEvent1", "BenchEvent2",
+                                                               "BenchEvent3"};
+} // namespace
+
+template <u32 N>
+struct BenchEvent {
+  static const EventType event_type;
+
+  u32 entity_id;
+  f32 amount;
+};
+
+template <u32 N>
+const EventType BenchEvent<N>::event_type{eventID(bench_event_names[N])};
+
+struct BenchListener {
+  u32 hits = 0;
+  f32 total = 0.0f;
+
+  template <typename E>
+  void onEvent(const E &event) {
+    ++hits;
+    total += event.amount;
+  }
+
+  template <typename E>
+  void onEvents(const E *events, u32 count) {
+    for (u32 i = 0; i < count; i++) {
+      total += events[i].amount;
+    }
+    hits += count;
+  }
+};
+
+template <u32 N>
+internal void addBenchListeners(EventDispatcher *dispatcher, BenchListener *listener) {
+  typedef BenchEvent<N> E;
+  dispatcher->addListener<E, BenchListener, &BenchListener::onEvent<E>>(listener);
+  dispatcher->addBatchListener<E, BenchListener, &BenchListener::onEvents<E>>(listener);
+}
+
+internal void queueBenchEvents(EventDispatcher *dispatcher, u32 event_count) {
+  // Types interleave like gameplay events do, so per-event delivery keeps switching listeners
+  for (u32 i = 0; i < event_count; i++) {
+    f32 amount = static_cast<f32>(i & 15);
+    switch (i % bench_event_types) {
+    case 0:
+      dispatcher->queueEvent(BenchEvent<0>{i, amount});
+      break;
+    case 1:
+      dispatcher->queueEvent(BenchEvent<1>{i, amount});
+      break;
+    case 2:
+      dispatcher->queueEvent(BenchEvent<2>{i, amount});
+      break;
+    default:
+      dispatcher->queueEvent(BenchEvent<3>{i, amount});
+      break;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  u32 event_counts[] = {10000, 100000};
+  u32 frames = argc > 1 ? static_cast<u32>(atoi(argv[1])) : 100;
+  if (!frames) {
+    frames = 1;
+  }
+
+  size_t storage_size = MB(64);
+  std::vector<u8> storage(storage_size);
+  // Neither is freed, the dispatcher lives as long as the program like it does in the game
+  auto allocator = new FreeListAllocator(storage_size, storage.data());
+  EventDispatcher *dispatcher = alloc<EventDispatcher>(allocator);
+  dispatcher->init(allocator, bench_ring_size);
+
+  BenchListener listener;
+  addBenchListeners<0>(dispatcher, &listener);
+  addBenchListeners<1>(dispatcher, &listener);
+  addBenchListeners<2>(dispatcher, &listener);
+  addBenchListeners<3>(dispatcher, &listener);
+
+  EventDispatchMode modes[] = {EventDispatchMode::PerEvent, EventDispatchMode::Batched};
+  const char *mode_names[] = {"per event", "batched"};
+
+  for (u32 event_count : event_counts) {
+    for (u32 mode_index = 0; mode_index < ARRAY_LEN(modes); mode_index++) {
+      dispatcher->dispatch_mode = modes[mode_index];
+
+      queueBenchEvents(dispatcher, event_count);
+      dispatcher->broadcast();
+
+      listener.hits = 0;
+      steady_clock::duration elapsed = steady_clock::duration::zero();
+      for (u32 frame = 0; frame < frames; frame++) {
+        queueBenchEvents(dispatcher, event_count);
+
+        auto start = steady_clock::now();
+        dispatcher->broadcast();
+        elapsed += steady_clock::now() - start;
+      }
+      f64 us = duration<f64, std::micro>(elapsed).count() / frames;
+
+      printf("%7u events  %-9s %10.1f us/broadcast  %6.1f ns/event  %u deliveries/frame\n", event_count,
+             mode_names[mode_index], us, 1000.0 * us / event_count, listener.hits / frames);
+    }
+  }
+
+  // keeps the listener work observable so it is not optimized away
+  printf("checksum %g\n", listener.total);
+
+  return 0;
+}
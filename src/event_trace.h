@@ -0,0 +1,40 @@
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <stdint.h>
+
+/************** Event trace format *****
+########################################################################################################################
+  Optional binary log of the event traffic: an EventTraceHeader followed by EventTraceRecords,
+  each followed by size payload bytes. Queued, posted, timed and fired events carry their payload
+  so an event storm can be replayed offline, delivered records only mark when dispatch happened.
+  Only needs <stdint.h>, so offline tools can read traces without the engine, SDL or GL.
+*/
+
+typedef uint64_t EventType;
+
+// Critical events are always delivered, the broadcast budget only applies to the others
+enum class EventPriority : uint8_t { Critical, Normal, Low, Count };
+
+enum class EventTraceKind : uint8_t { Queued, Posted, Timed, Fired, Delivered, Count };
+
+namespace {
+constexpr uint32_t event_trace_magic = 0x54455746;  // "FWET"
+constexpr uint32_t event_trace_version = 1;
+}  // namespace
+
+struct EventTraceHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+struct EventTraceRecord {
+    uint64_t clock;  // __rdtsc
+    EventType type;
+    uint32_t size;
+    EventTraceKind kind;
+    EventPriority priority;
+    uint16_t reserved;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+
+#include "event_trace.h"
+
+// Offline reader for the traces written by EventDispatcher::startTrace.
+// Prints per event type totals, or every record with --dump.
+// Only depends on the trace format, so it builds without SDL or GL.
+
+namespace {
+constexpr uint32_t event_trace_kind_count = static_cast<uint32_t>(EventTraceKind::Count);
+constexpr uint32_t max_payload_size = 4096;
+} // namespace
+
+struct EventTraceTotals {
+  uint64_t counts[event_trace_kind_count];
+  uint64_t payload_bytes;
+  uint64_t first_clock;
+  uint64_t last_clock;
+};
+
+static const char *eventTraceKindName(EventTraceKind kind) {
+  switch (kind) {
+  case EventTraceKind::Queued:
+    return "queued";
+  case EventTraceKind::Posted:
+    return "posted";
+  case EventTraceKind::Timed:
+    return "timed";
+  case EventTraceKind::Fired:
+    return "fired";
+  case EventTraceKind::Delivered:
+    return "delivered";
+  case EventTraceKind::Count:
+    break;
+  }
+
+  return "unknown";
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <trace file> [--dump]\n", argv[0]);
+    return 1;
+  }
+
+  FILE *file = fopen(argv[1], "rb");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s\n", argv[1]);
+    return 1;
+  }
+
+  bool dump = argc > 2 && strcmp(argv[2], "--dump") == 0;
+
+  EventTraceHeader header = {};
+  if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != event_trace_magic) {
+    fprintf(stderr, "%s is not an event trace\n", argv[1]);
+    fclose(file);
+    return 1;
+  }
+
+  if (header.version != event_trace_version) {
+    fprintf(stderr, "Unsupported event trace version %u\n", header.version);
+    fclose(file);
+    return 1;
+  }
+
+  std::map<EventType, EventTraceTotals> totals;
+  uint8_t payload[max_payload_size];
+  uint64_t record_count = 0;
+  uint64_t first_clock = 0;
+  EventTraceRecord record;
+  while (fread(&record, sizeof(record), 1, file) == 1) {
+    if (record.size > sizeof(payload) || (record.size && fread(payload, record.size, 1, file) != 1)) {
+      fprintf(stderr, "Truncated record %lu\n", static_cast<unsigned long>(record_count));
+      break;
+    }
+
+    if (!record_count) {
+      first_clock = record.clock;
+    }
+    ++record_count;
+
+    uint32_t kind = static_cast<uint32_t>(record.kind);
+    if (kind >= event_trace_kind_count) {
+      fprintf(stderr, "Unknown record kind %u\n", kind);
+      break;
+    }
+
+    EventTraceTotals &type_totals = totals[record.type];
+    if (!type_totals.first_clock) {
+      type_totals.first_clock = record.clock;
+    }
+    type_totals.last_clock = record.clock;
+    type_totals.counts[kind]++;
+    type_totals.payload_bytes += record.size;
+
+    if (dump) {
+      fprintf(stdout, "%12lu cy  type %4lu  %-9s  priority %u  %u bytes:", static_cast<unsigned long>(record.clock - first_clock),
+          static_cast<unsigned long>(record.type), eventTraceKindName(record.kind), static_cast<uint32_t>(record.priority),
+          record.size);
+      for (uint32_t i = 0; i < record.size && i < 32; i++) {
+        fprintf(stdout, " %02x", payload[i]);
+      }
+      fprintf(stdout, record.size > 32 ? " ...\n" : "\n");
+    }
+  }
+
+  fclose(file);
+
+  fprintf(stdout, "%lu records\n", static_cast<unsigned long>(record_count));
+  fprintf(stdout, "%6s %9s %9s %9s %9s %9s %12s %14s\n", "type", "queued", "posted", "timed", "fired", "delivered",
+      "bytes", "span (kcy)");
+  for (const auto &[type, type_totals] : totals) {
+    fprintf(stdout, "%6lu %9lu %9lu %9lu %9lu %9lu %12lu %14lu\n", static_cast<unsigned long>(type),
+        static_cast<unsigned long>(type_totals.counts[0]), static_cast<unsigned long>(type_totals.counts[1]),
+        static_cast<unsigned long>(type_totals.counts[2]), static_cast<unsigned long>(type_totals.counts[3]),
+        static_cast<unsigned long>(type_totals.counts[4]), static_cast<unsigned long>(type_totals.payload_bytes),
+        static_cast<unsigned long>((type_totals.last_clock - type_totals.first_clock) / 1000));
+  }
+
+  return 0;
+}
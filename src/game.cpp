@@ -6,6 +6,9 @@
 DebugTable g_debug_table;
 #endif
 
+// Reset every time the game code is loaded, game state is kept across loads
+global_var b32 game_code_loaded = false;
+
 extern "C" UPDATE_AND_RENDER(updateAndRender) {
 
 #ifdef FIREWOOD_INTERNAL
@@ -16,7 +19,7 @@ extern "C" UPDATE_AND_RENDER(updateAndRender) {
 
 
   if (!game_root.game_state) {
-    game_root.game_state = alloc<GameState>(memory.game_partition);
+    game_root.game_state = alloc<GameState>(memory.tagged(MemoryTag::Game));
   }
 
   GameState *game_state = game_root.game_state;
@@ -29,19 +32,55 @@ extern "C" UPDATE_AND_RENDER(updateAndRender) {
     renderer_2d.init(game_root.renderer_api, memory);
     renderer_2d.commands = commands;
 
-    game_state->renderer = alloc<Renderer>(memory.game_partition);
+    game_state->renderer = alloc<Renderer>(memory.tagged(MemoryTag::Game));
     game_state->renderer->commands = commands;
     game_state->renderer->renderer_2d = renderer_2d;
 
     game_state->material_texture = Texture::instance(game_root.renderer_api, memory);
-    game_state->material_texture->create("./assets/container.png");
+    memory.resource_heap->get<Texture>(game_state->material_texture)->create("./assets/container.png");
+  }
+
+  if (!game_root.event_dispatcher) {
+    game_root.event_dispatcher = alloc<EventDispatcher>(memory.tagged(MemoryTag::Events));
+    game_root.event_dispatcher->init(memory.tagged(MemoryTag::Events));
+#ifdef FIREWOOD_INTERNAL
+    if (const char *trace_path = getenv("FIREWOOD_EVENT_TRACE")) {
+      game_root.event_dispatcher->startTrace(trace_path);
+    }
+#endif
+  } else if (!game_code_loaded) {
+    game_root.event_dispatcher->onCodeReload();
+  }
+
+  if (!game_state->damage_bus) {
+    game_state->damage_bus = alloc<DamageBus>(memory.tagged(MemoryTag::Game), &game_state->damage_stats);
+  }
+
+  EventDispatcher *event_dispatcher = game_root.event_dispatcher;
+  if (!game_code_loaded) {
+    EventDispatcher::bind(event_dispatcher);
+
+    // Listeners point into the loaded code, so they are added again after every load
+    game_state->test_entity.init();
+    game_state->damage_bus->connect<EntityDamaged>(event_dispatcher);
+    game_code_loaded = true;
   }
 
   for (int controller_index = 0; controller_index < ARRAY_LEN(input->controllers); ++controller_index) {
     GameControllerInput *controller_input = getController(input, controller_index);
     game_state->camera_controller.update(controller_input, input->dt_for_frame);
+
+    // Every press of action down hits the test entity, the entity and DamageStats add it up
+    if (controller_input->action_down.ended_down && controller_input->action_down.half_transition_count) {
+      event_dispatcher->queueEvent(EntityDamaged{game_state->test_entity.id, 10.0f});
+    }
   }
 
+  BEGIN_PROFILE("Events broadcast");
+  event_dispatcher->advanceTime(input->dt_for_frame);
+  event_dispatcher->broadcast(2.0f);
+  END_PROFILE();
+
   Renderer *renderer = game_state->renderer;
   Renderer2D renderer_2d = renderer->renderer_2d;
 
@@ -70,6 +109,7 @@ extern "C" UPDATE_AND_RENDER(updateAndRender) {
   END_PROFILE();
 
   MEMORY_USAGE(memory);
+  MEMORY_TAGS(memory);
 
 #ifdef FIREWOOD_INTERNAL
   DEBUG_PlainConsolePrint(g_debug_table);
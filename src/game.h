@@ -1,6 +1,7 @@
 #include "game_events.cpp"
 #include "camera.cpp"
 #include "renderer.cpp"
+#include "quad_kernels.h"
 #include "renderer2D.cpp"
 #include "tile_map.cpp"
 
@@ -11,7 +12,11 @@ struct World {
 
 struct GameState {
   Renderer *renderer;
-  Texture *material_texture;
+  TextureHandle material_texture;
   b32 running;
   CameraController camera_controller;
+
+  TestEntity test_entity;
+  DamageStats damage_stats;
+  DamageBus *damage_bus;
 };
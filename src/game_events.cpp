@@ -9,7 +9,7 @@ struct EntityDestroyed : public EventData {
     void testEventFn() { std::cout << "triggered\n"; }
 };
 
-const EventType EntityDestroyed::event_type{genEventID()};
+const EventType EntityDestroyed::event_type{eventID("EntityDestroyed")};
 
 const char *EntityDestroyed::getName() const { return "EntityDestroyed"; }
 
@@ -19,6 +19,29 @@ EventDataPtr EntityDestroyed::copy() const {
     return EventDataPtr(new EntityDestroyed());
 }
 
+// POD event, queued by value without an EventData allocation
+struct EntityDamaged {
+    static const EventType event_type;
+
+    u32 entity_id;
+    f32 amount;
+};
+
+const EventType EntityDamaged::event_type{eventID("EntityDamaged")};
+
+// Handlers for the compile-time bus are plain structs, fire() calls onEvent directly
+struct DamageStats {
+    u32 hits = 0;
+    f32 total = 0.0f;
+
+    void onEvent(const EntityDamaged &event) {
+	++hits;
+	total += event.amount;
+    }
+};
+
+typedef StaticEventBus<DamageStats> DamageBus;
+
 internal u32 genEntityID() {
     local_var u32 entity_id = 0;
 
@@ -26,7 +49,10 @@ internal u32 genEntityID() {
 }
 
 struct TestEntity {
-    std::string id;
+    u32 id;
+    f32 damage_taken;
+    ListenerHandle destroyed_listener;
+    ListenerHandle damaged_listener;
 
     void destroyEventDelegate(EventDataPtr event_data) {
 	std::shared_ptr<EntityDestroyed> p_event_data =
@@ -34,15 +60,24 @@ struct TestEntity {
 	p_event_data->testEventFn();
     }
 
+    void onDamaged(const EntityDamaged &event) {
+	if (event.entity_id == id) {
+	    damage_taken += event.amount;
+	}
+    }
+
     void init() {
-	id = std::to_string(genEntityID());
-	EventDispatcher::instance()->addListener(
-	    id, this, &TestEntity::destroyEventDelegate,
-	    EntityDestroyed::event_type);
+	id = genEntityID();
+	EventDispatcher *dispatcher = EventDispatcher::instance();
+	destroyed_listener = dispatcher->addListener(
+	    this, &TestEntity::destroyEventDelegate, EntityDestroyed::event_type);
+	damaged_listener =
+	    dispatcher->addListener<EntityDamaged, TestEntity, &TestEntity::onDamaged>(this);
     }
 
     void destroy() {
-	EventDispatcher::instance()->removeListener(
-	    id, EntityDestroyed::event_type);
+	EventDispatcher *dispatcher = EventDispatcher::instance();
+	dispatcher->removeListener(destroyed_listener);
+	dispatcher->removeListener(damaged_listener);
     }
 };
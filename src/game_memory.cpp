@@ -15,7 +15,7 @@ inline u8 alignAdjustmentWithHdr(void *address, u8 alignment, u8 hdr_size) {
   u8 needed_space = hdr_size;
   if (adjustment < needed_space) {
     needed_space -= adjustment;
-    adjustment += adjustment * (needed_space / alignment);
+    adjustment += alignment * (needed_space / alignment);
 
     if (needed_space % alignment > 0)
       adjustment += alignment;
@@ -37,9 +37,69 @@ u8 *alignForward(void *memory, u8 alignment) {
   return memory_aligned;
 }
 
-inline void *add(void *ptr, uint32_t bytes) { return reinterpret_cast<void *>(reinterpret_cast<char *>(ptr) + bytes); }
+inline void *add(void *ptr, size_t bytes) { return reinterpret_cast<void *>(reinterpret_cast<char *>(ptr) + bytes); }
 
-inline void *sub(void *ptr, uint32_t bytes) { return reinterpret_cast<void *>(reinterpret_cast<char *>(ptr) - bytes); }
+inline void *sub(void *ptr, size_t bytes) { return reinterpret_cast<void *>(reinterpret_cast<char *>(ptr) - bytes); }
+
+inline size_t pageSize() {
+  local_var size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+  return page_size;
+}
+
+inline size_t alignUp(size_t value, size_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+// Address space only: nothing is backed until it is committed
+void *reserve(size_t size) {
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+  flags |= MAP_NORESERVE;
+#endif
+  void *ptr = mmap(0, size, PROT_NONE, flags, -1, 0);
+
+  return ptr != MAP_FAILED ? ptr : nullptr;
+}
+
+enum CommitFlags : u32 {
+  Commit_None = 0,
+  Commit_HugePages = 1 << 0, // ask for transparent huge pages to cut TLB misses
+  Commit_Prefault = 1 << 1,  // take the first-touch page faults now instead of in the frame loop
+};
+
+void prefault(void *ptr, size_t size) {
+#ifdef MADV_POPULATE_WRITE
+  if (madvise(ptr, size, MADV_POPULATE_WRITE) == 0)
+    return;
+#endif
+  // fallback for older kernels: touch every page
+  volatile u8 *bytes = reinterpret_cast<volatile u8 *>(ptr);
+  for (size_t offset = 0; offset < size; offset += pageSize()) {
+    bytes[offset] = bytes[offset];
+  }
+}
+
+bool commit(void *ptr, size_t size, u32 flags = 0) {
+  if (mprotect(ptr, size, PROT_READ | PROT_WRITE) != 0)
+    return false;
+
+#ifdef MADV_HUGEPAGE
+  if (flags & Commit_HugePages)
+    madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+
+  if (flags & Commit_Prefault)
+    prefault(ptr, size);
+
+  return true;
+}
+
+// Gives the pages back to the OS, the range stays reserved
+inline void decommit(void *ptr, size_t size) {
+  madvise(ptr, size, MADV_DONTNEED);
+  mprotect(ptr, size, PROT_NONE);
+}
+
+inline void release(void *ptr, size_t size) { munmap(ptr, size); }
 } // namespace memory
 
 struct Allocator {
@@ -60,40 +120,102 @@ struct Allocator {
   size_t num_allocations;
 };
 
-struct ProxyAllocator : public Allocator {
-  ProxyAllocator(Allocator &allocator);
+enum class MemoryTag { Renderer, Textures, TileMap, Events, Game, Count };
+
+namespace {
+constexpr u32 memory_tag_count = static_cast<u32>(MemoryTag::Count);
+} // namespace
+
+internal const char *memoryTagName(MemoryTag tag) {
+  switch (tag) {
+  case MemoryTag::Renderer:
+    return "Renderer";
+  case MemoryTag::Textures:
+    return "Textures";
+  case MemoryTag::TileMap:
+    return "TileMap";
+  case MemoryTag::Events:
+    return "Events";
+  case MemoryTag::Game:
+    return "Game";
+  case MemoryTag::Count:
+    break;
+  }
+
+  return "Unknown";
+}
+
+// Forwards to another allocator and keeps the statistics of one subsystem
+struct ProxyAllocator final : public Allocator {
+  ProxyAllocator(Allocator &allocator, MemoryTag tag = MemoryTag::Game);
 
   void *allocate(size_t size_in_bytes, u8 alignment) override;
   void deallocate(void *ptr) override;
+  void resetFrameStats();
+
+  // For memory that is handed out elsewhere but should count towards this tag, e.g. the resource heap
+  void recordAllocation(size_t size_in_bytes);
+  void recordDeallocation(size_t size_in_bytes);
 
   ProxyAllocator(const ProxyAllocator &) = delete;
   ProxyAllocator &operator=(const ProxyAllocator &) = delete;
 
+  MemoryTag tag;
+  size_t high_water;
+  size_t frame_allocations;
+
       private:
   Allocator &allocator;
 };
 
-ProxyAllocator::ProxyAllocator(Allocator &allocator)
-    : Allocator(allocator.size, allocator.start), allocator{allocator} {}
+ProxyAllocator::ProxyAllocator(Allocator &allocator, MemoryTag tag)
+    : Allocator(allocator.size, allocator.start), tag{tag}, high_water{0}, frame_allocations{0},
+      allocator{allocator} {}
 
 void *ProxyAllocator::allocate(size_t size_in_bytes, u8 alignment) {
   assert(size_in_bytes != 0);
-  num_allocations++;
   size_t mem = allocator.used_memory;
   void *ptr = allocator.allocate(size_in_bytes, alignment);
-  used_memory += allocator.used_memory - mem;
+  if (!ptr)
+    return nullptr;
+
+  recordAllocation(allocator.used_memory - mem);
 
   return ptr;
 }
 
 void ProxyAllocator::deallocate(void *ptr) {
-  num_allocations--;
   size_t mem = allocator.used_memory;
   allocator.deallocate(ptr);
-  used_memory -= mem - allocator.used_memory;
+  recordDeallocation(mem - allocator.used_memory);
+}
+
+inline void ProxyAllocator::resetFrameStats() { frame_allocations = 0; }
+
+inline void ProxyAllocator::recordAllocation(size_t size_in_bytes) {
+  num_allocations++;
+  frame_allocations++;
+  used_memory += size_in_bytes;
+  if (used_memory > high_water)
+    high_water = used_memory;
+}
+
+inline void ProxyAllocator::recordDeallocation(size_t size_in_bytes) {
+  num_allocations--;
+  used_memory -= size_in_bytes;
 }
 
-struct LinearAllocator : public Allocator {
+// Saved position of a linear/stack allocator. Everything allocated after
+// beginTemporaryMemory() is thrown away by the matching endTemporaryMemory().
+struct TemporaryMemory {
+  Allocator *allocator;
+  void *address;
+  size_t used_memory;
+  size_t num_allocations;
+  u32 depth;
+};
+
+struct LinearAllocator final : public Allocator {
   LinearAllocator(size_t size, void *start);
   ~LinearAllocator();
 
@@ -104,11 +226,16 @@ struct LinearAllocator : public Allocator {
   void deallocate(void *ptr) override;
   void clear();
 
+  TemporaryMemory beginTemporaryMemory();
+  void endTemporaryMemory(const TemporaryMemory &temp_memory);
+
       private:
   void *current_address;
+  u32 temporary_count;
 };
 
-LinearAllocator::LinearAllocator(size_t size, void *start) : Allocator(size, start), current_address{start} {
+LinearAllocator::LinearAllocator(size_t size, void *start)
+    : Allocator(size, start), current_address{start}, temporary_count{0} {
   assert(size > 0);
 }
 
@@ -131,12 +258,158 @@ void *LinearAllocator::allocate(size_t size_in_bytes, u8 alignment) {
 void LinearAllocator::deallocate(void *ptr) { assert(false && "Use clear() instead"); }
 
 void LinearAllocator::clear() {
+  assert(temporary_count == 0 && "Temporary memory is still in use");
+  num_allocations = 0;
+  used_memory = 0;
+  current_address = start;
+}
+
+TemporaryMemory LinearAllocator::beginTemporaryMemory() {
+  TemporaryMemory result;
+  result.allocator = this;
+  result.address = current_address;
+  result.used_memory = used_memory;
+  result.num_allocations = num_allocations;
+  result.depth = ++temporary_count;
+
+  return result;
+}
+
+void LinearAllocator::endTemporaryMemory(const TemporaryMemory &temp_memory) {
+  assert(temp_memory.allocator == this);
+  assert(temp_memory.depth == temporary_count && "Nested temporary memory has to be ended first");
+  assert(used_memory >= temp_memory.used_memory);
+
+  current_address = temp_memory.address;
+  used_memory = temp_memory.used_memory;
+  num_allocations = temp_memory.num_allocations;
+  temporary_count--;
+}
+
+// Two linear allocators used in turns: data allocated during frame N stays valid
+// while frame N + 1 is built, and is dropped at once when the buffer comes around again.
+struct FrameArena {
+  FrameArena(size_t size, void *start);
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  LinearAllocator *current();
+  LinearAllocator *previous();
+  void swap();
+
+  LinearAllocator buffers[2];
+  u32 current_index;
+};
+
+FrameArena::FrameArena(size_t size, void *start)
+    : buffers{{size / 2, start}, {size / 2, memory::add(start, size / 2)}}, current_index{0} {}
+
+inline LinearAllocator *FrameArena::current() { return &buffers[current_index]; }
+
+inline LinearAllocator *FrameArena::previous() { return &buffers[current_index ^ 1]; }
+
+void FrameArena::swap() {
+  current_index ^= 1;
+  buffers[current_index].clear();
+}
+
+// Linear allocator over a reserved address range. Pages are committed in commit_granularity
+// steps as allocations grow, so resident memory follows real use instead of the reserved size.
+struct VirtualAllocator final : public Allocator {
+  VirtualAllocator(size_t reserved_size, void *start, size_t commit_granularity = KB(64));
+  ~VirtualAllocator();
+
+  VirtualAllocator(const VirtualAllocator &) = delete;
+  VirtualAllocator &operator=(const VirtualAllocator &) = delete;
+
+  void *allocate(size_t size_in_bytes, u8 alignment) override;
+  void deallocate(void *ptr) override;
+  void clear(bool decommit = false);
+
+  TemporaryMemory beginTemporaryMemory();
+  void endTemporaryMemory(const TemporaryMemory &temp_memory);
+
+  size_t commit_granularity;
+  size_t committed_size;
+
+      private:
+  void *current_address;
+  u32 temporary_count;
+};
+
+VirtualAllocator::VirtualAllocator(size_t reserved_size, void *start, size_t commit_granularity)
+    : Allocator(reserved_size, start), committed_size{0}, current_address{start}, temporary_count{0} {
+  assert(reserved_size > 0);
+  this->commit_granularity = memory::alignUp(commit_granularity, memory::pageSize());
+}
+
+VirtualAllocator::~VirtualAllocator() { current_address = nullptr; }
+
+void *VirtualAllocator::allocate(size_t size_in_bytes, u8 alignment) {
+  assert(size_in_bytes != 0);
+  u8 adjustment = memory::alignAdjustment(current_address, alignment);
+  if (used_memory + adjustment + size_in_bytes > size)
+    return nullptr;
+
+  u8 *aligned_address = reinterpret_cast<u8 *>(memory::add(current_address, adjustment));
+  size_t end_offset = used_memory + adjustment + size_in_bytes;
+
+  if (end_offset > committed_size) {
+    size_t new_committed_size = memory::alignUp(end_offset, commit_granularity);
+    if (new_committed_size > size)
+      new_committed_size = size;
+
+    if (!memory::commit(memory::add(start, committed_size), new_committed_size - committed_size))
+      return nullptr;
+
+    committed_size = new_committed_size;
+  }
+
+  current_address = reinterpret_cast<void *>(aligned_address + size_in_bytes);
+  used_memory = end_offset;
+  num_allocations++;
+
+  return aligned_address;
+}
+
+void VirtualAllocator::deallocate(void *ptr) { assert(false && "Use clear() instead"); }
+
+void VirtualAllocator::clear(bool decommit) {
+  assert(temporary_count == 0 && "Temporary memory is still in use");
   num_allocations = 0;
   used_memory = 0;
   current_address = start;
+
+  if (decommit && committed_size > 0) {
+    memory::decommit(start, committed_size);
+    committed_size = 0;
+  }
 }
 
-struct StackAllocator : public Allocator {
+TemporaryMemory VirtualAllocator::beginTemporaryMemory() {
+  TemporaryMemory result;
+  result.allocator = this;
+  result.address = current_address;
+  result.used_memory = used_memory;
+  result.num_allocations = num_allocations;
+  result.depth = ++temporary_count;
+
+  return result;
+}
+
+void VirtualAllocator::endTemporaryMemory(const TemporaryMemory &temp_memory) {
+  assert(temp_memory.allocator == this);
+  assert(temp_memory.depth == temporary_count && "Nested temporary memory has to be ended first");
+  assert(used_memory >= temp_memory.used_memory);
+
+  current_address = temp_memory.address;
+  used_memory = temp_memory.used_memory;
+  num_allocations = temp_memory.num_allocations;
+  temporary_count--;
+}
+
+struct StackAllocator final : public Allocator {
   StackAllocator(size_t size, void *start);
   ~StackAllocator();
 
@@ -147,15 +420,20 @@ struct StackAllocator : public Allocator {
   void deallocate(void *ptr) override;
   void clear();
 
+  TemporaryMemory beginTemporaryMemory();
+  void endTemporaryMemory(const TemporaryMemory &temp_memory);
+
       private:
   struct Hdr {
     u8 adjustment;
   };
 
   void *current_address;
+  u32 temporary_count;
 };
 
-StackAllocator::StackAllocator(size_t size, void *start) : Allocator(size, start), current_address{start} {
+StackAllocator::StackAllocator(size_t size, void *start)
+    : Allocator(size, start), current_address{start}, temporary_count{0} {
   assert(size > 0);
 }
 
@@ -188,53 +466,786 @@ void StackAllocator::deallocate(void *ptr) {
   num_allocations--;
 }
 
-/************** Allocation new/delete ***************************
+TemporaryMemory StackAllocator::beginTemporaryMemory() {
+  TemporaryMemory result;
+  result.allocator = this;
+  result.address = current_address;
+  result.used_memory = used_memory;
+  result.num_allocations = num_allocations;
+  result.depth = ++temporary_count;
+
+  return result;
+}
+
+void StackAllocator::endTemporaryMemory(const TemporaryMemory &temp_memory) {
+  assert(temp_memory.allocator == this);
+  assert(temp_memory.depth == temporary_count && "Nested temporary memory has to be ended first");
+  assert(used_memory >= temp_memory.used_memory);
+
+  current_address = temp_memory.address;
+  used_memory = temp_memory.used_memory;
+  num_allocations = temp_memory.num_allocations;
+  temporary_count--;
+}
+
+struct PoolAllocator final : public Allocator {
+  PoolAllocator(size_t object_size, u8 object_alignment, size_t size, void *start);
+  ~PoolAllocator();
+
+  PoolAllocator(const PoolAllocator &) = delete;
+  PoolAllocator &operator=(const PoolAllocator &) = delete;
+
+  void *allocate(size_t size_in_bytes, u8 alignment) override;
+  void deallocate(void *ptr) override;
+  // Frees every slot at once, without touching the objects in them
+  void clear();
+
+  size_t object_size;
+  u8 object_alignment;
+
+      private:
+  // Free slots store the pointer to the next free slot in their first bytes
+  void **free_list;
+};
+
+PoolAllocator::PoolAllocator(size_t object_size, u8 object_alignment, size_t size, void *start)
+    : Allocator(size, start), object_alignment{object_alignment} {
+  assert(object_size >= sizeof(void *));
+  assert((object_alignment & (object_alignment - 1)) == 0);
+
+  // every slot has to keep the alignment of the first one
+  this->object_size = (object_size + object_alignment - 1) & ~(static_cast<size_t>(object_alignment) - 1);
+
+  clear();
+}
+
+PoolAllocator::~PoolAllocator() { free_list = nullptr; }
+
+void PoolAllocator::clear() {
+  u8 adjustment = memory::alignAdjustment(start, object_alignment);
+  size_t num_objects = (size - adjustment) / object_size;
+  assert(num_objects > 0);
+
+  free_list = reinterpret_cast<void **>(memory::add(start, adjustment));
+
+  void **slot = free_list;
+  for (size_t i = 0; i < num_objects - 1; i++) {
+    *slot = memory::add(slot, object_size);
+    slot = reinterpret_cast<void **>(*slot);
+  }
+
+  *slot = nullptr;
+  used_memory = 0;
+  num_allocations = 0;
+}
+
+void *PoolAllocator::allocate(size_t size_in_bytes, u8 alignment) {
+  assert(size_in_bytes != 0);
+  assert(size_in_bytes <= object_size && alignment <= object_alignment);
+
+  if (!free_list)
+    return nullptr;
+
+  void *ptr = free_list;
+  free_list = reinterpret_cast<void **>(*free_list);
+
+  used_memory += object_size;
+  num_allocations++;
+
+  return ptr;
+}
+
+void PoolAllocator::deallocate(void *ptr) {
+  *(reinterpret_cast<void **>(ptr)) = free_list;
+  free_list = reinterpret_cast<void **>(ptr);
+
+  used_memory -= object_size;
+  num_allocations--;
+}
+
+enum class FitPolicy { FirstFit, BestFit };
+
+struct FreeListAllocator final : public Allocator {
+  FreeListAllocator(size_t size, void *start, FitPolicy fit_policy = FitPolicy::FirstFit);
+  ~FreeListAllocator();
+
+  FreeListAllocator(const FreeListAllocator &) = delete;
+  FreeListAllocator &operator=(const FreeListAllocator &) = delete;
+
+  void *allocate(size_t size_in_bytes, u8 alignment) override;
+  void deallocate(void *ptr) override;
+
+  FitPolicy fit_policy;
+
+      private:
+  struct Hdr {
+    size_t size;
+    u8 adjustment;
+  };
+
+  // Free blocks are kept sorted by address so neighbours can be merged on deallocate
+  struct FreeBlock {
+    size_t size;
+    FreeBlock *next;
+  };
+
+  FreeBlock *free_blocks;
+};
+
+FreeListAllocator::FreeListAllocator(size_t size, void *start, FitPolicy fit_policy)
+    : Allocator(size, start), fit_policy{fit_policy} {
+  assert(size > sizeof(FreeBlock));
+
+  free_blocks = reinterpret_cast<FreeBlock *>(start);
+  free_blocks->size = size;
+  free_blocks->next = nullptr;
+}
+
+FreeListAllocator::~FreeListAllocator() { free_blocks = nullptr; }
+
+void *FreeListAllocator::allocate(size_t size_in_bytes, u8 alignment) {
+  assert(size_in_bytes != 0);
+
+  // headers and split-off free blocks have to stay aligned themselves
+  if (alignment < alignof(Hdr))
+    alignment = alignof(Hdr);
+
+  FreeBlock *prev_free_block = nullptr;
+  FreeBlock *free_block = free_blocks;
+
+  FreeBlock *best_prev_block = nullptr;
+  FreeBlock *best_block = nullptr;
+  u8 best_adjustment = 0;
+  size_t best_total_size = 0;
+
+  while (free_block) {
+    u8 adjustment = memory::alignAdjustmentWithHdr(free_block, alignment, sizeof(Hdr));
+    size_t total_size = size_in_bytes + adjustment;
+    total_size = (total_size + alignof(FreeBlock) - 1) & ~(alignof(FreeBlock) - 1);
+
+    if (free_block->size >= total_size && (!best_block || free_block->size < best_block->size)) {
+      best_prev_block = prev_free_block;
+      best_block = free_block;
+      best_adjustment = adjustment;
+      best_total_size = total_size;
+
+      if (fit_policy == FitPolicy::FirstFit || free_block->size == total_size)
+        break;
+    }
+
+    prev_free_block = free_block;
+    free_block = free_block->next;
+  }
+
+  if (!best_block)
+    return nullptr;
+
+  // if the rest is too small to hold a free block, give it away with the allocation
+  if (best_block->size - best_total_size <= sizeof(FreeBlock)) {
+    best_total_size = best_block->size;
+
+    if (best_prev_block)
+      best_prev_block->next = best_block->next;
+    else
+      free_blocks = best_block->next;
+  } else {
+    FreeBlock *next_block = reinterpret_cast<FreeBlock *>(memory::add(best_block, best_total_size));
+    next_block->size = best_block->size - best_total_size;
+    next_block->next = best_block->next;
+
+    if (best_prev_block)
+      best_prev_block->next = next_block;
+    else
+      free_blocks = next_block;
+  }
+
+  void *aligned_address = memory::add(best_block, best_adjustment);
+
+  Hdr *header = reinterpret_cast<Hdr *>(memory::sub(aligned_address, sizeof(Hdr)));
+  header->size = best_total_size;
+  header->adjustment = best_adjustment;
+
+  used_memory += best_total_size;
+  num_allocations++;
+
+  return aligned_address;
+}
+
+void FreeListAllocator::deallocate(void *ptr) {
+  assert(ptr);
+
+  Hdr *header = reinterpret_cast<Hdr *>(memory::sub(ptr, sizeof(Hdr)));
+  uintptr_t block_start = reinterpret_cast<uintptr_t>(ptr) - header->adjustment;
+  size_t block_size = header->size;
+  uintptr_t block_end = block_start + block_size;
+
+  FreeBlock *prev_free_block = nullptr;
+  FreeBlock *free_block = free_blocks;
+
+  while (free_block) {
+    if (reinterpret_cast<uintptr_t>(free_block) >= block_end)
+      break;
+
+    prev_free_block = free_block;
+    free_block = free_block->next;
+  }
+
+  if (!prev_free_block) {
+    prev_free_block = reinterpret_cast<FreeBlock *>(block_start);
+    prev_free_block->size = block_size;
+    prev_free_block->next = free_blocks;
+
+    free_blocks = prev_free_block;
+  } else if (reinterpret_cast<uintptr_t>(prev_free_block) + prev_free_block->size == block_start) {
+    prev_free_block->size += block_size;
+  } else {
+    FreeBlock *block = reinterpret_cast<FreeBlock *>(block_start);
+    block->size = block_size;
+    block->next = prev_free_block->next;
+
+    prev_free_block->next = block;
+    prev_free_block = block;
+  }
+
+  if (free_block && reinterpret_cast<uintptr_t>(prev_free_block) + prev_free_block->size ==
+                        reinterpret_cast<uintptr_t>(free_block)) {
+    prev_free_block->size += free_block->size;
+    prev_free_block->next = free_block->next;
+  }
+
+  used_memory -= block_size;
+  num_allocations--;
+}
+
+/************** Relocatable resource heap **********************
 ################################################################
 */
 
-template <typename T> 
-T *alloc(Allocator *allocator) { return new (allocator->allocate(sizeof(T), alignof(T))) T; }
+struct ResourceHandle {
+  u32 index;
+  u32 generation; // 0 is never handed out, so a zeroed handle is invalid
+
+  inline bool isValid() const { return generation != 0; }
+  inline bool operator==(const ResourceHandle &other) const {
+    return index == other.index && generation == other.generation;
+  }
+  inline bool operator!=(const ResourceHandle &other) const { return !(*this == other); }
+};
+
+// Resources are reached through generational handles instead of pointers, which lets
+// compact() slide live blocks down over freed ones, a bounded number of bytes per call.
+// Pointers returned by get() stay valid only until the next compact(), and stored objects
+// have to survive being moved with memmove (no pointers into themselves).
+struct ResourceHeap {
+  ResourceHeap(size_t size, void *start, u32 max_handles, ProxyAllocator *tag = nullptr);
+
+  ResourceHeap(const ResourceHeap &) = delete;
+  ResourceHeap &operator=(const ResourceHeap &) = delete;
+
+  ResourceHandle allocate(size_t size_in_bytes);
+  void free(ResourceHandle handle);
+  void *get(ResourceHandle handle) const;
+
+  template <typename T, typename... Args>
+  ResourceHandle create(Args &&... args);
+  template <typename T>
+  void destroy(ResourceHandle handle);
+  template <typename T>
+  inline T *get(ResourceHandle handle) const {
+    return reinterpret_cast<T *>(get(handle));
+  }
+
+  // Moves at most max_bytes of live data, returns the number of bytes moved
+  size_t compact(size_t max_bytes);
+
+  size_t used_memory;
+  size_t free_memory; // bytes of freed blocks not reclaimed yet
+  size_t num_allocations;
+
+  // Telemetry only, live blocks are also counted here
+  ProxyAllocator *tag;
+
+      private:
+  struct Entry {
+    void *ptr;
+    u32 generation;
+    u32 next_free;
+  };
+
+  struct BlockHdr {
+    u32 handle_index;
+    b32 live;
+    size_t size; // header included
+  };
+
+  Entry *entries;
+  u32 max_handles;
+  u32 first_free_entry;
+
+  uintptr_t data_start;
+  uintptr_t data_end;
+  uintptr_t top;
+
+  // compaction pass state: blocks below write_cursor are packed, scan_cursor is the next block to look at
+  uintptr_t scan_cursor;
+  uintptr_t write_cursor;
+};
+
+namespace {
+constexpr u32 invalid_entry = 0xffffffff;
+} // namespace
+
+ResourceHeap::ResourceHeap(size_t size, void *start, u32 max_handles, ProxyAllocator *tag)
+    : used_memory{0}, free_memory{0}, num_allocations{0}, tag{tag}, max_handles{max_handles}, first_free_entry{0} {
+  assert(max_handles > 0);
+  entries = reinterpret_cast<Entry *>(start);
+  for (u32 i = 0; i < max_handles; i++) {
+    entries[i].ptr = nullptr;
+    entries[i].generation = 1;
+    entries[i].next_free = i + 1 < max_handles ? i + 1 : invalid_entry;
+  }
+
+  data_start = memory::alignUp(reinterpret_cast<uintptr_t>(start) + sizeof(Entry) * max_handles, 16);
+  data_end = reinterpret_cast<uintptr_t>(start) + size;
+  assert(data_start < data_end);
+
+  top = data_start;
+  scan_cursor = write_cursor = data_start;
+}
+
+ResourceHandle ResourceHeap::allocate(size_t size_in_bytes) {
+  assert(size_in_bytes != 0);
+
+  ResourceHandle result = {};
+  if (first_free_entry == invalid_entry)
+    return result;
+
+  size_t block_size = memory::alignUp(sizeof(BlockHdr) + size_in_bytes, 16);
+  if (top + block_size > data_end) {
+    // out of room at the top, finish the compaction in one go and try again
+    compact(data_end - data_start);
+    if (top + block_size > data_end)
+      return result;
+  }
+
+  u32 index = first_free_entry;
+  Entry &entry = entries[index];
+  first_free_entry = entry.next_free;
+
+  BlockHdr *header = reinterpret_cast<BlockHdr *>(top);
+  header->handle_index = index;
+  header->live = true;
+  header->size = block_size;
+  top += block_size;
+
+  entry.ptr = header + 1;
+  entry.next_free = invalid_entry;
+
+  used_memory += block_size;
+  num_allocations++;
+  if (tag)
+    tag->recordAllocation(block_size);
+
+  result.index = index;
+  result.generation = entry.generation;
+
+  return result;
+}
+
+void ResourceHeap::free(ResourceHandle handle) {
+  assert(handle.index < max_handles);
+  Entry &entry = entries[handle.index];
+  assert(entry.generation == handle.generation && "Resource is already freed");
+
+  BlockHdr *header = reinterpret_cast<BlockHdr *>(entry.ptr) - 1;
+  header->live = false;
+
+  used_memory -= header->size;
+  free_memory += header->size;
+  num_allocations--;
+  if (tag)
+    tag->recordDeallocation(header->size);
+
+  entry.ptr = nullptr;
+  entry.generation++;
+  if (entry.generation == 0)
+    entry.generation = 1;
+
+  entry.next_free = first_free_entry;
+  first_free_entry = handle.index;
+}
+
+void *ResourceHeap::get(ResourceHandle handle) const {
+  if (handle.index >= max_handles)
+    return nullptr;
+
+  const Entry &entry = entries[handle.index];
+
+  return entry.generation == handle.generation ? entry.ptr : nullptr;
+}
+
+size_t ResourceHeap::compact(size_t max_bytes) {
+  if (!free_memory && scan_cursor == write_cursor)
+    return 0;
+
+  size_t moved = 0;
+  while (scan_cursor < top && moved < max_bytes) {
+    BlockHdr *header = reinterpret_cast<BlockHdr *>(scan_cursor);
+    size_t block_size = header->size;
+
+    if (header->live) {
+      if (scan_cursor != write_cursor) {
+        memmove(reinterpret_cast<void *>(write_cursor), header, block_size);
+        entries[reinterpret_cast<BlockHdr *>(write_cursor)->handle_index].ptr =
+            reinterpret_cast<BlockHdr *>(write_cursor) + 1;
+        moved += block_size;
+      }
+
+      write_cursor += block_size;
+    }
+
+    scan_cursor += block_size;
+  }
+
+  if (scan_cursor == top) {
+    // pass finished: everything between write_cursor and top was dead
+    free_memory -= top - write_cursor;
+    top = write_cursor;
+    scan_cursor = write_cursor = data_start;
+  }
+
+  return moved;
+}
 
 template <typename T, typename... Args>
-T *alloc(Allocator *allocator, Args &&... args) {
-  return new (allocator->allocate(sizeof(T), alignof(T))) T(args...);
+ResourceHandle ResourceHeap::create(Args &&... args) {
+  static_assert(alignof(T) <= 16, "ResourceHeap blocks are 16 byte aligned");
+  ResourceHandle handle = allocate(sizeof(T));
+  if (handle.isValid())
+    new (get(handle)) T(std::forward<Args>(args)...);
+
+  return handle;
 }
 
-template <typename T, size_t N>
-T *alloc_array(Allocator *allocator) {
+template <typename T>
+void ResourceHeap::destroy(ResourceHandle handle) {
+  T *object = get<T>(handle);
+  assert(object);
+  object->~T();
+  free(handle);
+}
+
+/************** Thread-safe allocators *************************
+################################################################
+*/
+
+// Lock-free linear allocator: threads claim memory with a single fetch_add on the offset.
+// The claim includes the worst case alignment padding, so no compare-and-swap loop is needed.
+struct ConcurrentLinearAllocator final : public Allocator {
+  ConcurrentLinearAllocator(size_t size, void *start);
+  ~ConcurrentLinearAllocator();
+
+  ConcurrentLinearAllocator(const ConcurrentLinearAllocator &) = delete;
+  ConcurrentLinearAllocator &operator=(const ConcurrentLinearAllocator &) = delete;
+
+  void *allocate(size_t size_in_bytes, u8 alignment) override;
+  void deallocate(void *ptr) override;
+
+  // Only call it when no other thread allocates, e.g. between frames
+  void clear();
+
+  // Bumped by clear() so thread arenas know their block is gone
+  std::atomic<u32> generation;
+
+      private:
+  std::atomic<size_t> offset;
+};
+
+ConcurrentLinearAllocator::ConcurrentLinearAllocator(size_t size, void *start)
+    : Allocator(size, start), generation{0}, offset{0} {
+  assert(size > 0);
+}
+
+ConcurrentLinearAllocator::~ConcurrentLinearAllocator() {}
+
+void *ConcurrentLinearAllocator::allocate(size_t size_in_bytes, u8 alignment) {
+  assert(size_in_bytes != 0);
+  size_t claimed_size = size_in_bytes + alignment - 1;
+  size_t claimed_offset = offset.fetch_add(claimed_size, std::memory_order_relaxed);
+  if (claimed_offset + claimed_size > size)
+    return nullptr;
+
+  uintptr_t address = reinterpret_cast<uintptr_t>(start) + claimed_offset;
+  address = (address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+
+  __atomic_fetch_add(&used_memory, claimed_size, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&num_allocations, 1, __ATOMIC_RELAXED);
+
+  return reinterpret_cast<void *>(address);
+}
+
+void ConcurrentLinearAllocator::deallocate(void *ptr) { assert(false && "Use clear() instead"); }
+
+void ConcurrentLinearAllocator::clear() {
+  offset.store(0, std::memory_order_relaxed);
+  used_memory = 0;
+  num_allocations = 0;
+  generation.fetch_add(1, std::memory_order_release);
+}
+
+namespace {
+constexpr size_t thread_arena_block_size = KB(64);
+} // namespace
+
+// Per-thread bump allocator refilled in blocks from a ConcurrentLinearAllocator,
+// so most allocations on a worker thread do not touch shared state at all.
+struct ThreadArena {
+  void *allocate(size_t size_in_bytes, u8 alignment = 16);
+
+  ConcurrentLinearAllocator *source;
+  u32 generation;
+  uintptr_t current;
+  uintptr_t end;
+};
+
+void *ThreadArena::allocate(size_t size_in_bytes, u8 alignment) {
+  assert(source && size_in_bytes != 0);
+
+  u32 source_generation = source->generation.load(std::memory_order_acquire);
+  if (generation != source_generation) {
+    generation = source_generation;
+    current = end = 0;
+  }
+
+  uintptr_t address = (current + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+  if (!current || address + size_in_bytes > end) {
+    // big requests go straight to the shared allocator and keep the current block
+    if (size_in_bytes + alignment > thread_arena_block_size / 4)
+      return source->allocate(size_in_bytes, alignment);
+
+    void *block = source->allocate(thread_arena_block_size, 16);
+    if (!block)
+      return nullptr;
+
+    current = reinterpret_cast<uintptr_t>(block);
+    end = current + thread_arena_block_size;
+    address = (current + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+  }
+
+  current = address + size_in_bytes;
+
+  return reinterpret_cast<void *>(address);
+}
+
+ThreadArena *threadArena(ConcurrentLinearAllocator *source) {
+  thread_local ThreadArena arena = {};
+  if (arena.source != source) {
+    arena = {};
+    arena.source = source;
+    arena.generation = source->generation.load(std::memory_order_acquire);
+  }
+
+  return &arena;
+}
+
+namespace {
+constexpr u32 pool_magazine_size = 32;
+constexpr u32 max_concurrent_pools = 4;
+} // namespace
+
+struct ConcurrentPoolAllocator;
+
+// Per-thread cache of free pool slots. Only refills and spills touch the shared pool.
+// Kept trivially destructible: a thread_local with a destructor would run after the
+// platform unmapped the block and would pin game.so under glibc, breaking hot reload.
+struct PoolMagazine {
+  u32 count;
+  void *slots[pool_magazine_size];
+};
+
+// Thread-safe front-end over a PoolAllocator. Each thread allocates from its own magazine
+// and only takes the spin lock to move half a magazine from or to the shared pool.
+struct ConcurrentPoolAllocator final : public Allocator {
+  ConcurrentPoolAllocator(size_t object_size, u8 object_alignment, size_t size, void *start);
+  ~ConcurrentPoolAllocator();
+
+  ConcurrentPoolAllocator(const ConcurrentPoolAllocator &) = delete;
+  ConcurrentPoolAllocator &operator=(const ConcurrentPoolAllocator &) = delete;
+
+  void *allocate(size_t size_in_bytes, u8 alignment) override;
+  void deallocate(void *ptr) override;
+
+  void refill(PoolMagazine &magazine);
+  void spill(PoolMagazine &magazine, u32 count);
+
+  // Returns the calling thread's cached slots to the pool. Worker threads call
+  // it before they exit, otherwise those slots stay unavailable.
+  void flushThreadCache();
+
+      private:
+  PoolMagazine &magazine();
+
+  PoolAllocator pool;
+  std::atomic_flag lock = ATOMIC_FLAG_INIT;
+  u32 id;
+};
+
+ConcurrentPoolAllocator::ConcurrentPoolAllocator(size_t object_size, u8 object_alignment, size_t size, void *start)
+    : Allocator(size, start), pool{object_size, object_alignment, size, start} {
+  local_var std::atomic<u32> next_id{0};
+  id = next_id.fetch_add(1);
+  assert(id < max_concurrent_pools && "Raise max_concurrent_pools");
+}
+
+ConcurrentPoolAllocator::~ConcurrentPoolAllocator() {}
+
+inline PoolMagazine &ConcurrentPoolAllocator::magazine() {
+  thread_local PoolMagazine magazines[max_concurrent_pools];
+  return magazines[id];
+}
+
+void ConcurrentPoolAllocator::flushThreadCache() {
+  PoolMagazine &cache = magazine();
+  if (cache.count)
+    spill(cache, cache.count);
+}
+
+void ConcurrentPoolAllocator::refill(PoolMagazine &magazine) {
+  while (lock.test_and_set(std::memory_order_acquire)) {
+    _mm_pause();
+  }
+
+  while (magazine.count < pool_magazine_size / 2) {
+    void *slot = pool.allocate(pool.object_size, pool.object_alignment);
+    if (!slot)
+      break;
+
+    magazine.slots[magazine.count++] = slot;
+  }
+
+  lock.clear(std::memory_order_release);
+}
+
+void ConcurrentPoolAllocator::spill(PoolMagazine &magazine, u32 count) {
+  while (lock.test_and_set(std::memory_order_acquire)) {
+    _mm_pause();
+  }
+
+  while (count--) {
+    pool.deallocate(magazine.slots[--magazine.count]);
+  }
+
+  lock.clear(std::memory_order_release);
+}
+
+void *ConcurrentPoolAllocator::allocate(size_t size_in_bytes, u8 alignment) {
+  assert(size_in_bytes != 0);
+  assert(size_in_bytes <= pool.object_size && alignment <= pool.object_alignment);
+
+  PoolMagazine &cache = magazine();
+  if (!cache.count) {
+    refill(cache);
+    if (!cache.count)
+      return nullptr;
+  }
+
+  __atomic_fetch_add(&used_memory, pool.object_size, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&num_allocations, 1, __ATOMIC_RELAXED);
+
+  return cache.slots[--cache.count];
+}
+
+void ConcurrentPoolAllocator::deallocate(void *ptr) {
+  PoolMagazine &cache = magazine();
+  if (cache.count == pool_magazine_size)
+    spill(cache, pool_magazine_size / 2);
+
+  cache.slots[cache.count++] = ptr;
+
+  __atomic_fetch_sub(&used_memory, pool.object_size, __ATOMIC_RELAXED);
+  __atomic_fetch_sub(&num_allocations, 1, __ATOMIC_RELAXED);
+}
+
+template <typename A>
+struct ScopedTemporaryMemory {
+  explicit ScopedTemporaryMemory(A *allocator)
+      : allocator{allocator}, temp_memory{allocator->beginTemporaryMemory()} {}
+  ~ScopedTemporaryMemory() { allocator->endTemporaryMemory(temp_memory); }
+
+  ScopedTemporaryMemory(const ScopedTemporaryMemory &) = delete;
+  ScopedTemporaryMemory &operator=(const ScopedTemporaryMemory &) = delete;
+
+  A *allocator;
+  TemporaryMemory temp_memory;
+};
+
+/************** Allocation new/delete ***************************
+################################################################
+*/
+
+// Concrete allocators are final, so when the allocator type is known at compile time the call
+// is made directly and can be inlined, e.g. alloc<T>(LinearAllocator *) becomes a pointer bump.
+// Passing a plain Allocator * keeps the type-erased virtual path.
+template <typename A>
+inline void *allocateFrom(A *allocator, size_t size_in_bytes, u8 alignment) {
+  static_assert(std::is_base_of<Allocator, A>::value, "A has to implement the Allocator interface");
+  if constexpr (std::is_final<A>::value)
+    return allocator->A::allocate(size_in_bytes, alignment);
+  else
+    return allocator->allocate(size_in_bytes, alignment);
+}
+
+template <typename A>
+inline void deallocateFrom(A *allocator, void *ptr) {
+  static_assert(std::is_base_of<Allocator, A>::value, "A has to implement the Allocator interface");
+  if constexpr (std::is_final<A>::value)
+    allocator->A::deallocate(ptr);
+  else
+    allocator->deallocate(ptr);
+}
+
+template <typename T, typename A>
+T *alloc(A *allocator) { return new (allocateFrom(allocator, sizeof(T), alignof(T))) T; }
+
+template <typename T, typename A, typename... Args>
+T *alloc(A *allocator, Args &&... args) {
+  return new (allocateFrom(allocator, sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
+
+template <typename T, size_t N, typename A>
+T *alloc_array(A *allocator) {
   constexpr size_t length = N;
   static_assert(length != 0, "Length of array should be at least 1.");
 
   u8 header_size = sizeof(size_t) / sizeof(T);
-  if (sizeof(size_t) + sizeof(T) > 0)
+  if (sizeof(size_t) % sizeof(T) > 0)
     header_size += 1;
-    T *ptr = (reinterpret_cast<T *>(allocator->allocate(sizeof(T) * (length + header_size), alignof(T)))) + header_size; 
+    T *ptr = (reinterpret_cast<T *>(allocateFrom(allocator, sizeof(T) * (length + header_size), alignof(T)))) + header_size; 
 
     *((reinterpret_cast<size_t*>(ptr)) - 1) = length;
 
     for (size_t i = 0; i < length; i++) {
-        new (&ptr) T;
+        new (&ptr[i]) T;
     }
 
     return ptr;
 }
 
-template <typename T>
-void dealloc_array(Allocator *allocator, T *array)
+template <typename T, typename A>
+void dealloc_array(A *allocator, T *array)
 {
   size_t length = *((reinterpret_cast<size_t *>(array)) - 1);
-  for (size_t i = 0; i < length; i++) array->~T();
+  for (size_t i = 0; i < length; i++) array[i].~T();
   
   u8 header_size = sizeof(size_t) / sizeof(T);
   if (sizeof(size_t) % sizeof(T) > 0) {
     header_size += 1;
   } 
 
-  allocator->deallocate(array - header_size);
+  deallocateFrom(allocator, array - header_size);
 }
 
-template <typename T> void dealloc(Allocator *allocator, T *object) {
+template <typename T, typename A> void dealloc(A *allocator, T *object) {
   object->~T();
-  allocator->deallocate(object);
+  deallocateFrom(allocator, object);
 }
-
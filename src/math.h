@@ -14,6 +14,38 @@ template <typename T>
 constexpr T square(T value) {
     return value * value;
 }
+
+// Cody-Waite split of Pi/2 and the minimax coefficients on [-Pi/4, Pi/4] used
+// by sinCosDegrees. The SIMD quad kernels evaluate the very same polynomials.
+constexpr f32 half_pi_1 = 1.5703125f;
+constexpr f32 half_pi_2 = 4.837512969970703125e-4f;
+constexpr f32 half_pi_3 = 7.54978995489188216e-8f;
+constexpr f32 sin_c0 = -1.6666654611e-1f;
+constexpr f32 sin_c1 = 8.3321608736e-3f;
+constexpr f32 sin_c2 = -1.9515295891e-4f;
+constexpr f32 cos_c0 = 4.166664568298827e-2f;
+constexpr f32 cos_c1 = -1.388731625493765e-3f;
+constexpr f32 cos_c2 = 2.443315711809948e-5f;
+
+inline void sinCosDegrees(f32 deg, f32 &sin_t, f32 &cos_t) {
+    f32 x = radians(deg);
+    i32 quadrant = static_cast<i32>(lrintf(x * (2.0f / Pi)));
+    f32 q = static_cast<f32>(quadrant);
+    f32 r = ((x - q * half_pi_1) - q * half_pi_2) - q * half_pi_3;
+    f32 r2 = r * r;
+
+    f32 s = r + r * r2 * (sin_c0 + r2 * (sin_c1 + r2 * sin_c2));
+    f32 c = 1.0f - 0.5f * r2 + r2 * r2 * (cos_c0 + r2 * (cos_c1 + r2 * cos_c2));
+
+    if (quadrant & 1) {
+	f32 t = s;
+	s = c;
+	c = t;
+    }
+
+    sin_t = (quadrant & 2) ? -s : s;
+    cos_t = ((quadrant + 1) & 2) ? -c : c;
+}
 }  // namespace math
 
 template <typename T>
@@ -416,6 +448,30 @@ inline v4 operator*(const Mat4x4 &m, v4 p) {
     return result;
 }
 
+// 2x3 affine transform for the plane, the last column is the translation
+struct Affine2D {
+    f32 e[2][3]; // ROW-MAJOR entries
+};
+
+// Same transform as translate(pos) * rotZ(angle) * scale(size), angle in degrees
+inline Affine2D affine2D(const v2 &pos, const v2 &size, f32 angle) {
+    f32 sin_t;
+    f32 cos_t;
+    math::sinCosDegrees(angle, sin_t, cos_t);
+
+    Affine2D result = {
+	{{cos_t * size.x, -sin_t * size.y, pos.x},
+	 {sin_t * size.x, cos_t * size.y, pos.y}}
+    };
+
+    return result;
+}
+
+inline v2 operator*(const Affine2D &m, v2 p) {
+    return v2(m.e[0][2] + m.e[0][0]*p.x + m.e[0][1]*p.y,
+	      m.e[1][2] + m.e[1][0]*p.x + m.e[1][1]*p.y);
+}
+
 template <typename T>
 struct Point3 : Vector3<T> {
     Point3() = default;
@@ -71,6 +71,15 @@ typedef const GLubyte *APIENTRY type_glGetStringi(GLenum name, GLuint index);
 typedef void APIENTRY type_glDrawElementsBaseVertex(
     GLenum mode, GLsizei count, GLenum type, const void *indices, GLint basevertex);
 typedef void APIENTRY type_glGenerateMipmap(GLenum target);
+typedef void APIENTRY type_glDrawElementsInstanced(
+    GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount);
+typedef void APIENTRY type_glVertexAttribDivisor(GLuint index, GLuint divisor);
+typedef void APIENTRY type_glBufferStorage(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void *APIENTRY type_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean APIENTRY type_glUnmapBuffer(GLenum target);
+typedef GLsync APIENTRY type_glFenceSync(GLenum condition, GLbitfield flags);
+typedef GLenum APIENTRY type_glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout);
+typedef void APIENTRY type_glDeleteSync(GLsync sync);
 #define openGLFunction(name) type_##name *name
 
 struct OpenGL {
@@ -130,17 +139,50 @@ struct OpenGL {
   openGLFunction(glGenerateMipmap);
   openGLFunction(glDeleteBuffers);
   openGLFunction(glDeleteVertexArrays);
+  openGLFunction(glDrawElementsInstanced);
+  openGLFunction(glVertexAttribDivisor);
+  openGLFunction(glBufferStorage); // null without GL_ARB_buffer_storage
+  openGLFunction(glMapBufferRange);
+  openGLFunction(glUnmapBuffer);
+  openGLFunction(glFenceSync);
+  openGLFunction(glClientWaitSync);
+  openGLFunction(glDeleteSync);
+};
+
+namespace {
+constexpr u32 max_stream_buffers = 8;
+constexpr u32 stream_segments = 3; // Frames in flight per streaming buffer
+} // namespace
+
+struct OpenGLVertexBuffer;
+
+// Ring position and fences of a streaming buffer. The buffer itself lives in game memory, which
+// a snapshot restore rewinds; this state follows the GPU and stays with the renderer api instead.
+struct OpenGLStream {
+  OpenGLVertexBuffer *buffer;
+  u32 segment;
+  u32 write_offset;
+  GLsync fences[stream_segments];
 };
 
 class OpenGLRendererAPI : public RendererAPI {
   OpenGL *context;
 
+  // Streaming vertex buffers, fenced and moved to their next frame segment together in endFrame
+  OpenGLStream streams[max_stream_buffers] = {};
+
   void *getContext() override;
   void init(SDL_Window *window) override;
   void drawIndexed(VertexArray *vertex_array, u32 index_count = 0) override;
+  void drawIndexedInstanced(VertexArray *vertex_array, u32 index_count, u32 instance_count) override;
+  void endFrame() override;
   void setAttributes();
   OpenGL *rendererAlloc(size_t size);
   void clear(v3 color) override;
+
+ public:
+  OpenGLStream *addStream(OpenGLVertexBuffer *buffer);
+  void removeStream(OpenGLStream *stream);
 };
 
 void OpenGLRendererAPI::clear(v3 color) {
@@ -163,6 +205,12 @@ void OpenGLRendererAPI::drawIndexed(VertexArray *vertex_array, u32 index_count)
   glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void OpenGLRendererAPI::drawIndexedInstanced(VertexArray *vertex_array, u32 index_count, u32 instance_count) {
+  vertex_array->bind();
+  context->glDrawElementsInstanced(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, nullptr, instance_count);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 OpenGL *OpenGLRendererAPI::rendererAlloc(size_t size) {
   void *memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
   OpenGL *result = reinterpret_cast<OpenGL *>(memory != MAP_FAILED ? memory : 0);
@@ -240,6 +288,20 @@ void OpenGLRendererAPI::init(SDL_Window *window) {
     SDL_GetOpenGLFunction(glGenerateMipmap);
     SDL_GetOpenGLFunction(glDeleteBuffers);
     SDL_GetOpenGLFunction(glDeleteVertexArrays);
+    SDL_GetOpenGLFunction(glDrawElementsInstanced);
+    SDL_GetOpenGLFunction(glVertexAttribDivisor);
+    SDL_GetOpenGLFunction(glBufferStorage);
+    SDL_GetOpenGLFunction(glMapBufferRange);
+    SDL_GetOpenGLFunction(glUnmapBuffer);
+    SDL_GetOpenGLFunction(glFenceSync);
+    SDL_GetOpenGLFunction(glClientWaitSync);
+    SDL_GetOpenGLFunction(glDeleteSync);
+
+    // The proc address can resolve even when the driver does not expose the
+    // extension, streaming buffers fall back to orphaning in that case
+    if (!SDL_GL_ExtensionSupported("GL_ARB_buffer_storage")) {
+      context->glBufferStorage = nullptr;
+    }
 
   } else {
     fprintf(stderr, "Fail to create context %s", SDL_GetError());
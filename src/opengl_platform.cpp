@@ -1,5 +1,11 @@
 #include "opengl_def.h"
 
+namespace {
+constexpr u32 stream_batches_per_frame = 8;         // Batches one frame segment holds
+constexpr u32 stream_batch_alignment = 64;
+constexpr GLuint64 stream_fence_timeout = 1000000; // ns, a wait that times out is simply retried
+} // namespace
+
 internal GLenum mapElemToShaderType(ShaderDataType type) {
   switch (type) {
   case Float:
@@ -111,19 +117,36 @@ void OpenGLShader::uploadInt(const char *name, i32 value) {
 }
 
 struct OpenGLVertexBuffer : public VertexBuffer {
-  OpenGLVertexBuffer(RendererAPI *renderer_api) {
+  OpenGLVertexBuffer(RendererAPI *renderer_api, Allocator *allocator) {
     open_gl = reinterpret_cast<OpenGL *>(renderer_api->getContext());
+    api = static_cast<OpenGLRendererAPI *>(renderer_api);
+    elements.init(allocator);
   }
 
-  ~OpenGLVertexBuffer() { open_gl->glDeleteBuffers(1, &vbo); }
+  ~OpenGLVertexBuffer() {
+    if (stream) {
+      api->removeStream(stream);
+    }
+    open_gl->glDeleteBuffers(1, &vbo);
+  }
 
   OpenGLVertexBuffer(OpenGL *open_gl) : open_gl{open_gl} {}
 
   unsigned int vbo;
   u32 stride;
 
+  // Streaming ring: a persistent mapping of stream_segments segments, one per
+  // frame in flight. Batches are suballocated from the current segment at
+  // write_offset, and the segment is fenced once after the frame's last draw.
+  // mapped stays null when the driver lacks buffer storage, the buffer is
+  // then orphaned and mapped anew for every batch.
+  u8 *mapped = nullptr;
+  u32 batch_size = 0;
+  u32 segment_size = 0;
+  OpenGLStream *stream = nullptr;
+
   OpenGL *open_gl;
-  std::vector<Element> elements_data;
+  OpenGLRendererAPI *api = nullptr;
 
   u32 getStride() override;
   void create(u32 size) override;
@@ -131,7 +154,11 @@ struct OpenGLVertexBuffer : public VertexBuffer {
   inline void bind() override;
   inline void unbind() override;
   void setData(const void *data, u32 size) override;
-  void setLayout(std::vector<Element> elements) override;
+  void setLayout(const Element *layout, u32 count) override;
+  void createStream(u32 segment_size) override;
+  void *beginWrite() override;
+  size_t endWrite(u32 size) override;
+  void endFrame();
   void calcOffsetAndStride();
 };
 
@@ -140,8 +167,12 @@ void OpenGLVertexBuffer::setData(const void *data, u32 size) {
   open_gl->glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
 }
 
-void OpenGLVertexBuffer::setLayout(std::vector<Element> elements) {
-  this->elements = elements;
+void OpenGLVertexBuffer::setLayout(const Element *layout, u32 count) {
+  elements.clear();
+  elements.reserve(count);
+  for (u32 i = 0; i < count; i++) {
+    elements.push(layout[i]);
+  }
 
   calcOffsetAndStride();
 }
@@ -170,6 +201,112 @@ void OpenGLVertexBuffer::create(f32 *vertices, u32 size) {
   open_gl->glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
 }
 
+void OpenGLVertexBuffer::createStream(u32 batch_size) {
+  assert(api && "Streaming buffers need the renderer api");
+  this->batch_size = batch_size;
+  segment_size = batch_size * stream_batches_per_frame;
+  stream = api->addStream(this);
+
+  open_gl->glGenBuffers(1, &vbo);
+  open_gl->glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+  if (open_gl->glBufferStorage) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr size = static_cast<GLsizeiptr>(segment_size) * stream_segments;
+    open_gl->glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+    mapped = reinterpret_cast<u8 *>(open_gl->glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+    assert(mapped && "Failed to map streaming buffer");
+  } else {
+    open_gl->glBufferData(GL_ARRAY_BUFFER, batch_size, nullptr, GL_STREAM_DRAW);
+  }
+}
+
+void *OpenGLVertexBuffer::beginWrite() {
+  if (mapped) {
+    if (stream->write_offset + batch_size > segment_size) {
+      // The frame outgrew its segment, it goes on in the next one as if a frame had ended
+      endFrame();
+    }
+
+    // Last read stream_segments frames ago, the wait only blocks when the GPU is that far behind
+    GLsync &segment_fence = stream->fences[stream->segment];
+    if (segment_fence) {
+      GLenum result = open_gl->glClientWaitSync(segment_fence, GL_SYNC_FLUSH_COMMANDS_BIT, stream_fence_timeout);
+      while (result == GL_TIMEOUT_EXPIRED) {
+        result = open_gl->glClientWaitSync(segment_fence, GL_SYNC_FLUSH_COMMANDS_BIT, stream_fence_timeout);
+      }
+      open_gl->glDeleteSync(segment_fence);
+      segment_fence = nullptr;
+    }
+
+    return mapped + static_cast<size_t>(stream->segment) * segment_size + stream->write_offset;
+  }
+
+  open_gl->glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  open_gl->glBufferData(GL_ARRAY_BUFFER, batch_size, nullptr, GL_STREAM_DRAW);
+  void *result = open_gl->glMapBufferRange(GL_ARRAY_BUFFER, 0, batch_size,
+                                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  assert(result && "Failed to map streaming buffer");
+
+  return result;
+}
+
+size_t OpenGLVertexBuffer::endWrite(u32 size) {
+  assert(size <= batch_size);
+
+  if (mapped) {
+    // Coherent mapping, the writes are visible to any draw issued from here on
+    size_t offset = static_cast<size_t>(stream->segment) * segment_size + stream->write_offset;
+    stream->write_offset += (size + stream_batch_alignment - 1) & ~(stream_batch_alignment - 1);
+
+    return offset;
+  }
+
+  open_gl->glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  open_gl->glUnmapBuffer(GL_ARRAY_BUFFER);
+
+  return 0;
+}
+
+// Not virtual: called from the platform through OpenGLRendererAPI::endFrame
+void OpenGLVertexBuffer::endFrame() {
+  if (mapped && stream->write_offset) {
+    stream->fences[stream->segment] = open_gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->segment = (stream->segment + 1) % stream_segments;
+    stream->write_offset = 0;
+  }
+}
+
+OpenGLStream *OpenGLRendererAPI::addStream(OpenGLVertexBuffer *buffer) {
+  for (OpenGLStream &stream : streams) {
+    if (!stream.buffer) {
+      stream = {};
+      stream.buffer = buffer;
+      return &stream;
+    }
+  }
+
+  assert(false && "Too many streaming buffers");
+  return nullptr;
+}
+
+void OpenGLRendererAPI::removeStream(OpenGLStream *stream) {
+  for (GLsync fence : stream->fences) {
+    if (fence) {
+      context->glDeleteSync(fence);
+    }
+  }
+  *stream = {};
+}
+
+void OpenGLRendererAPI::endFrame() {
+  for (OpenGLStream &stream : streams) {
+    if (stream.buffer) {
+      stream.buffer->endFrame();
+    }
+  }
+}
+
 inline void OpenGLVertexBuffer::bind() {
   open_gl->glBindBuffer(GL_ARRAY_BUFFER, vbo);
 }
@@ -241,6 +378,17 @@ struct OpenGLTexture : public Texture {
   const char *path;
 };
 
+// RGBA8 texels, checked once when the data is uploaded
+internal b32 hasTranslucentTexels(const u8 *texels, u32 count) {
+  for (u32 i = 0; i < count; i++) {
+    if (texels[i * 4 + 3] != 0xFF) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 void OpenGLTexture::create(u32 width, u32 height)
 { 
    data_format_ = GL_RGBA;
@@ -277,6 +425,7 @@ void OpenGLTexture::create(const char *path) {
   }
 
   data_format_ = data_format;
+  translucent = data_format == GL_RGBA && hasTranslucentTexels(data, width * height);
 
   glGenTextures(1, &texture);
   glBindTexture(GL_TEXTURE_2D, texture);
@@ -296,6 +445,7 @@ void OpenGLTexture::setData(void *data, u32 size)
 {
   u32 bpp = data_format_ == GL_RGBA ? 4 : 3;
   assert(size == width * height * bpp && "Texture should be defined entirely!");
+  translucent = data_format_ == GL_RGBA && hasTranslucentTexels(reinterpret_cast<u8 *>(data), width * height);
 
   glTexImage2D(GL_TEXTURE_2D, 0, data_format_, width, height, 0, data_format_,
                GL_UNSIGNED_BYTE, data);
@@ -313,8 +463,10 @@ void OpenGLTexture::bind(u32 slot) {
 }
 
 struct OpenGLVertexArray : public VertexArray {
-  OpenGLVertexArray(RendererAPI *renderer_api) {
+  OpenGLVertexArray(RendererAPI *renderer_api, Allocator *allocator) : vertex_buffer_index{0} {
     open_gl = reinterpret_cast<OpenGL *>(renderer_api->getContext());
+    vertex_buffers.init(allocator);
+    first_attributes.init(allocator);
   }
 
   ~OpenGLVertexArray() { open_gl->glDeleteVertexArrays(1, &vao); }
@@ -325,11 +477,14 @@ struct OpenGLVertexArray : public VertexArray {
   u32 vertex_buffer_index;
   u32 vao;
   int component_count;
-  std::vector<VertexBuffer *> vertex_buffers;
+  Array<VertexBuffer *> vertex_buffers;
+  Array<u32> first_attributes; // attribute index of the first element of each buffer
 
   void create() override;
   void setIndexBuffer(IndexBuffer *buffer) override;
   void addBuffer(VertexBuffer *buffer) override;
+  void setBufferOffset(VertexBuffer *buffer, size_t offset) override;
+  void pointAttributes(VertexBuffer *buffer, u32 first_attribute, size_t offset);
 
   inline void bind() override;
   inline void unbind() override;
@@ -344,23 +499,44 @@ void OpenGLVertexArray::setIndexBuffer(IndexBuffer *buffer) {
   index_buffer = buffer;
 }
 
+void OpenGLVertexArray::pointAttributes(VertexBuffer *buffer, u32 first_attribute, size_t offset) {
+  u32 index = first_attribute;
+  for (const auto &elem : buffer->elements) {
+    open_gl->glVertexAttribPointer(
+        index, elem.getComponentCount(),
+        mapElemToShaderType(elem.type), elem.normalized ? GL_TRUE : GL_FALSE,
+        buffer->getStride(), reinterpret_cast<const void *>(offset + elem.offset));
+    index++;
+  }
+}
+
 void OpenGLVertexArray::addBuffer(VertexBuffer *buffer) {
   open_gl->glBindVertexArray(vao);
   buffer->bind();
 
-  std::vector<Element> elements;
-  elements.assign(buffer->elements.begin(), buffer->elements.end());
+  first_attributes.push(vertex_buffer_index);
+  pointAttributes(buffer, vertex_buffer_index, 0);
 
-  for (const auto &elem : elements) {
+  for (u32 i = 0; i < buffer->elements.count; i++) {
     open_gl->glEnableVertexAttribArray(vertex_buffer_index);
-    open_gl->glVertexAttribPointer(
-        vertex_buffer_index, elem.getComponentCount(),
-        mapElemToShaderType(elem.type), elem.normalized ? GL_TRUE : GL_FALSE,
-        buffer->getStride(), reinterpret_cast<const void *>(elem.offset));
+    if (buffer->divisor) {
+      open_gl->glVertexAttribDivisor(vertex_buffer_index, buffer->divisor);
+    }
     vertex_buffer_index++;
   }
 
-  vertex_buffers.push_back(buffer);
+  vertex_buffers.push(buffer);
+}
+
+void OpenGLVertexArray::setBufferOffset(VertexBuffer *buffer, size_t offset) {
+  open_gl->glBindVertexArray(vao);
+  buffer->bind();
+
+  for (u32 i = 0; i < vertex_buffers.count; i++) {
+    if (vertex_buffers[i] == buffer) {
+      pointAttributes(buffer, first_attributes[i], offset);
+    }
+  }
 }
 
 inline void OpenGLVertexArray::bind() { open_gl->glBindVertexArray(vao); }
@@ -371,7 +547,7 @@ VertexBuffer *VertexBuffer::instance(RendererAPI *renderer_api,
                                      const MemoryStorage &memory) {
   switch (renderer_type) {
   case RendererType::OpenGL_API:
-    return alloc<OpenGLVertexBuffer>(memory.resource_partition, renderer_api);
+    return alloc<OpenGLVertexBuffer>(memory.tagged(MemoryTag::Renderer), renderer_api, memory.tagged(MemoryTag::Renderer));
   }
 
   return nullptr;
@@ -381,27 +557,27 @@ IndexBuffer *IndexBuffer::instance(RendererAPI *renderer_api,
                                    const MemoryStorage &memory) {
   switch (renderer_type) {
   case RendererType::OpenGL_API:
-    return alloc<OpenGLIndexBuffer>(memory.resource_partition, renderer_api);
+    return alloc<OpenGLIndexBuffer>(memory.tagged(MemoryTag::Renderer), renderer_api);
   }
 
   return nullptr;
 }
 
-Texture *Texture::instance(RendererAPI *renderer_api,
-                           const MemoryStorage &memory) {
+TextureHandle Texture::instance(RendererAPI *renderer_api,
+                                const MemoryStorage &memory) {
   switch (renderer_type) {
   case RendererType::OpenGL_API:
-    return alloc<OpenGLTexture>(memory.resource_partition, renderer_api);
+    return memory.resource_heap->create<OpenGLTexture>(renderer_api);
   }
 
-  return nullptr;
+  return {};
 }
 
 VertexArray *VertexArray::instance(RendererAPI *renderer_api,
                                    const MemoryStorage &memory) {
   switch (renderer_type) {
   case RendererType::OpenGL_API:
-    return alloc<OpenGLVertexArray>(memory.resource_partition, renderer_api);
+    return alloc<OpenGLVertexArray>(memory.tagged(MemoryTag::Renderer), renderer_api, memory.tagged(MemoryTag::Renderer));
   }
 
   return nullptr;
@@ -411,7 +587,7 @@ Shader *Shader::instance(RendererAPI *renderer_api,
                          const MemoryStorage &memory) {
   switch (renderer_type) {
   case RendererType::OpenGL_API:
-    return alloc<OpenGLShader>(memory.resource_partition, renderer_api);
+    return alloc<OpenGLShader>(memory.tagged(MemoryTag::Renderer), renderer_api);
   }
 
   return nullptr;
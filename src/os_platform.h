@@ -2,6 +2,7 @@
 #define OS_PLATFORM_H
 
 #include <stdint.h>
+#include <string.h>
 
 typedef uint8_t u8;
 typedef uint16_t u16;
@@ -18,12 +19,15 @@ typedef double f64;
 
 typedef int32_t b32;
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <deque>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <string>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 #include <array>
 
@@ -32,6 +36,7 @@ using namespace std::chrono;
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
 #include <sys/mman.h>
+#include <unistd.h>
 #include <x86intrin.h>
 
 #define internal static
@@ -50,15 +55,29 @@ using namespace std::chrono;
 #include "math.h"
 #include "utils.h"
 #include "input.h"
-#include "event.h"
 #include "game_memory.cpp"
+#include "containers.h"
 #include "debug_service.h"
+#include "event.h"
 
 enum class RendererType { OpenGL_API };
 
+namespace {
+constexpr size_t object_pool_slot_size = 128; // Small objects with independent lifetimes e.g. job payloads
+} // namespace
+
 struct MemoryStorage {
-    StackAllocator *resource_partition;
-    LinearAllocator *game_partition;
+    FreeListAllocator *resource_partition;
+    VirtualAllocator *game_partition;
+    FrameArena *frame_arena;
+    ConcurrentLinearAllocator *job_partition;
+    ConcurrentPoolAllocator *job_pool;
+    ResourceHeap *resource_heap;
+
+    // Per-subsystem views over the partitions above, used for memory telemetry
+    ProxyAllocator *tagged_partitions[memory_tag_count];
+
+    inline ProxyAllocator *tagged(MemoryTag tag) const { return tagged_partitions[static_cast<u32>(tag)]; }
 };
 
 #define GRAPHICS_PLATFORM_API OPEN_GL
@@ -74,6 +93,7 @@ struct GameRoot {
     RendererAPI *renderer_api;
     GameState *game_state;
     DebugTable *debug_table;
+    EventDispatcher *event_dispatcher;  // in game memory, the platform releases its EventData events
 };
 
 #include "opengl_platform.cpp"
@@ -0,0 +1,108 @@
+#include "os_platform.h"
+#include "camera.h"
+#include "renderer.h"
+#include "quad_kernels.h"
+
+// Times the quad transform kernels at 10k and 100k quads per frame, next to
+// the per-quad matrix build Renderer2D::drawQuad does. Prints milliseconds per
+// frame and the largest corner deviation from the scalar kernel.
+
+#ifdef FIREWOOD_INTERNAL
+DebugTable g_debug_table;
+#endif
+
+struct QuadKernelEntry {
+  const char *name;
+  QuadKernel *kernel;
+  b32 supported;
+};
+
+internal void quadKernelMatrix(const QuadBatch &batch, u32 first, u32 count, f32 tex_index, QuadVertex *out) {
+  v4 quad_vertices[4] = {{-0.5f, -0.5f, 0.0f, 1.0f}, {0.5f, -0.5f, 0.0f, 1.0f}, {0.5f, 0.5f, 0.0f, 1.0f},
+                         {-0.5f, 0.5f, 0.0f, 1.0f}};
+
+  for (u32 i = first; i < first + count; i++) {
+    v3 pos = {batch.x[i], batch.y[i], batch.z ? batch.z[i] : 0.0f};
+    Mat4x4 tran = translate(pos) * rotZ(batch.angle[i]) * scale({batch.width[i], batch.height[i], 0.0f});
+
+    for (u32 j = 0; j < 4; j++) {
+      out->position = tran * quad_vertices[j];
+      out->color = batch.color[i];
+      out->tex_coord = {quad_tex_coords[j][0], quad_tex_coords[j][1]};
+      out->tex_index = tex_index;
+      out++;
+    }
+  }
+}
+
+internal f32 randomRange(u32 &state, f32 min, f32 max) {
+  state = state * 1664525u + 1013904223u;
+  return min + (max - min) * static_cast<f32>(state >> 8) / static_cast<f32>(1 << 24);
+}
+
+int main(int argc, char **argv) {
+  __builtin_cpu_init();
+
+  QuadKernelEntry kernels[] = {
+      {"matrix", quadKernelMatrix, true},
+      {"scalar", quadKernelScalar, true},
+      {"sse4.1", quadKernelSSE, __builtin_cpu_supports("sse4.1")},
+      {"avx2", quadKernelAVX2, __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")},
+  };
+
+  u32 quad_counts[] = {10000, 100000};
+  u32 frames = argc > 1 ? static_cast<u32>(atoi(argv[1])) : 100;
+  if (!frames) {
+    frames = 1;
+  }
+
+  for (u32 quad_count : quad_counts) {
+    std::vector<f32> x(quad_count);
+    std::vector<f32> y(quad_count);
+    std::vector<f32> width(quad_count);
+    std::vector<f32> height(quad_count);
+    std::vector<f32> angle(quad_count);
+    std::vector<v4> color(quad_count);
+
+    u32 state = 1;
+    for (u32 i = 0; i < quad_count; i++) {
+      x[i] = randomRange(state, -100.0f, 100.0f);
+      y[i] = randomRange(state, -100.0f, 100.0f);
+      width[i] = randomRange(state, 0.1f, 4.0f);
+      height[i] = randomRange(state, 0.1f, 4.0f);
+      angle[i] = randomRange(state, -720.0f, 720.0f);
+      color[i] = {randomRange(state, 0.0f, 1.0f), randomRange(state, 0.0f, 1.0f), randomRange(state, 0.0f, 1.0f), 1.0f};
+    }
+
+    QuadBatch batch = {quad_count, x.data(), y.data(), nullptr, width.data(), height.data(), angle.data(), color.data()};
+
+    std::vector<QuadVertex> reference(quad_count * 4);
+    std::vector<QuadVertex> out(quad_count * 4);
+    quadKernelScalar(batch, 0, quad_count, 0.0f, reference.data());
+
+    for (const QuadKernelEntry &entry : kernels) {
+      if (!entry.supported) {
+        printf("%7u quads  %-7s not supported by this cpu\n", quad_count, entry.name);
+        continue;
+      }
+
+      entry.kernel(batch, 0, quad_count, 0.0f, out.data());
+
+      auto start = steady_clock::now();
+      for (u32 frame = 0; frame < frames; frame++) {
+        entry.kernel(batch, 0, quad_count, 0.0f, out.data());
+      }
+      f64 ms = duration<f64, std::milli>(steady_clock::now() - start).count() / frames;
+
+      f32 max_error = 0.0f;
+      for (u32 i = 0; i < quad_count * 4; i++) {
+        max_error = std::max(max_error, fabsf(out[i].position.x - reference[i].position.x));
+        max_error = std::max(max_error, fabsf(out[i].position.y - reference[i].position.y));
+      }
+
+      printf("%7u quads  %-7s %8.3f ms/frame  max error %g\n", quad_count, entry.name, ms, max_error);
+    }
+  }
+
+  return 0;
+}
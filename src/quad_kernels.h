@@ -0,0 +1,254 @@
+#ifndef QUAD_KERNELS_H
+#define QUAD_KERNELS_H
+
+// Batch transform of QuadBatch entries into QuadVertex records, 4 vertices
+// per quad in the corner order of Renderer2D_Data::quad_vertices. The SIMD
+// kernels evaluate the same rotation polynomial as math::sinCosDegrees, so any
+// of them can stand in for the scalar one.
+
+typedef void QuadKernel(const QuadBatch &batch, u32 first, u32 count, f32 tex_index, QuadVertex *out);
+
+namespace {
+constexpr f32 quad_tex_coords[4][2] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}};
+} // namespace
+
+internal inline void writeQuad(QuadVertex *out, const f32 *corner_x, const f32 *corner_y, f32 z, const v4 &color,
+                               f32 tex_index) {
+  for (u32 i = 0; i < 4; i++) {
+    out[i].position = {corner_x[i], corner_y[i], z};
+    out[i].color = color;
+    out[i].tex_coord = {quad_tex_coords[i][0], quad_tex_coords[i][1]};
+    out[i].tex_index = tex_index;
+  }
+}
+
+// Axis-aligned quads are plain min/max corners, rotated ones go through an
+// Affine2D. With a = cos*w/2, b = sin*w/2, d = cos*h/2, e = sin*h/2 the rotated
+// corners are offset from the centre by (-a+e, -b-d), (a+e, b-d), (a-e, b+d),
+// (-a-e, -b+d), which is what the SIMD kernels compute lane-wise.
+template <bool Rotated>
+internal inline void quadCorners(f32 x, f32 y, f32 width, f32 height, f32 angle, f32 *corner_x, f32 *corner_y) {
+  if constexpr (Rotated) {
+    Affine2D tran = affine2D({x, y}, {width, height}, angle);
+    for (u32 i = 0; i < 4; i++) {
+      v2 corner = tran * v2(quad_tex_coords[i][0] - 0.5f, quad_tex_coords[i][1] - 0.5f);
+      corner_x[i] = corner.x;
+      corner_y[i] = corner.y;
+    }
+  } else {
+    f32 min_x = x - 0.5f * width;
+    f32 max_x = x + 0.5f * width;
+    f32 min_y = y - 0.5f * height;
+    f32 max_y = y + 0.5f * height;
+
+    corner_x[0] = min_x;
+    corner_x[1] = max_x;
+    corner_x[2] = max_x;
+    corner_x[3] = min_x;
+    corner_y[0] = min_y;
+    corner_y[1] = min_y;
+    corner_y[2] = max_y;
+    corner_y[3] = max_y;
+  }
+}
+
+internal void quadKernelScalar(const QuadBatch &batch, u32 first, u32 count, f32 tex_index, QuadVertex *out) {
+  for (u32 i = first; i < first + count; i++) {
+    f32 corner_x[4];
+    f32 corner_y[4];
+
+    if (batch.angle[i] == 0.0f) {
+      quadCorners<false>(batch.x[i], batch.y[i], batch.width[i], batch.height[i], 0.0f, corner_x, corner_y);
+    } else {
+      quadCorners<true>(batch.x[i], batch.y[i], batch.width[i], batch.height[i], batch.angle[i], corner_x, corner_y);
+    }
+
+    writeQuad(out, corner_x, corner_y, batch.z ? batch.z[i] : 0.0f, batch.color[i], tex_index);
+    out += 4;
+  }
+}
+
+/************** SSE4.1, 4 quads per iteration *****
+##############################################################################
+*/
+
+__attribute__((target("sse4.1"))) internal inline void sinCosDegrees4(__m128 deg, __m128 &sin_t, __m128 &cos_t) {
+  __m128i one = _mm_set1_epi32(1);
+  __m128i two = _mm_set1_epi32(2);
+
+  __m128 x = _mm_mul_ps(deg, _mm_set1_ps(Pi / 180));
+  __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(2.0f / Pi)));
+  __m128 q = _mm_cvtepi32_ps(quadrant);
+  __m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(math::half_pi_1)));
+  r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(math::half_pi_2)));
+  r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(math::half_pi_3)));
+  __m128 r2 = _mm_mul_ps(r, r);
+
+  __m128 s = _mm_add_ps(_mm_set1_ps(math::sin_c1), _mm_mul_ps(r2, _mm_set1_ps(math::sin_c2)));
+  s = _mm_add_ps(_mm_set1_ps(math::sin_c0), _mm_mul_ps(r2, s));
+  s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), s));
+
+  __m128 c = _mm_add_ps(_mm_set1_ps(math::cos_c1), _mm_mul_ps(r2, _mm_set1_ps(math::cos_c2)));
+  c = _mm_add_ps(_mm_set1_ps(math::cos_c0), _mm_mul_ps(r2, c));
+  c = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)), _mm_mul_ps(_mm_mul_ps(r2, r2), c));
+
+  __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+  __m128 sin_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+  __m128 cos_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30));
+
+  sin_t = _mm_xor_ps(_mm_blendv_ps(s, c, swap), sin_sign);
+  cos_t = _mm_xor_ps(_mm_blendv_ps(c, s, swap), cos_sign);
+}
+
+__attribute__((target("sse4.1"))) internal void quadKernelSSE(const QuadBatch &batch, u32 first, u32 count,
+                                                              f32 tex_index, QuadVertex *out) {
+  __m128 half = _mm_set1_ps(0.5f);
+  u32 end = first + count;
+  u32 i = first;
+
+  for (; i + 4 <= end; i += 4) {
+    __m128 sin_t;
+    __m128 cos_t;
+    sinCosDegrees4(_mm_loadu_ps(batch.angle + i), sin_t, cos_t);
+
+    __m128 half_w = _mm_mul_ps(half, _mm_loadu_ps(batch.width + i));
+    __m128 half_h = _mm_mul_ps(half, _mm_loadu_ps(batch.height + i));
+    __m128 a = _mm_mul_ps(cos_t, half_w);
+    __m128 b = _mm_mul_ps(sin_t, half_w);
+    __m128 d = _mm_mul_ps(cos_t, half_h);
+    __m128 e = _mm_mul_ps(sin_t, half_h);
+
+    __m128 x = _mm_loadu_ps(batch.x + i);
+    __m128 y = _mm_loadu_ps(batch.y + i);
+
+    // [corner][lane], transposed to one quad per lane below
+    alignas(16) f32 corner_x[4][4];
+    alignas(16) f32 corner_y[4][4];
+    _mm_store_ps(corner_x[0], _mm_add_ps(_mm_sub_ps(x, a), e));
+    _mm_store_ps(corner_x[1], _mm_add_ps(_mm_add_ps(x, a), e));
+    _mm_store_ps(corner_x[2], _mm_sub_ps(_mm_add_ps(x, a), e));
+    _mm_store_ps(corner_x[3], _mm_sub_ps(_mm_sub_ps(x, a), e));
+    _mm_store_ps(corner_y[0], _mm_sub_ps(_mm_sub_ps(y, b), d));
+    _mm_store_ps(corner_y[1], _mm_sub_ps(_mm_add_ps(y, b), d));
+    _mm_store_ps(corner_y[2], _mm_add_ps(_mm_add_ps(y, b), d));
+    _mm_store_ps(corner_y[3], _mm_add_ps(_mm_sub_ps(y, b), d));
+
+    for (u32 lane = 0; lane < 4; lane++) {
+      f32 quad_x[4] = {corner_x[0][lane], corner_x[1][lane], corner_x[2][lane], corner_x[3][lane]};
+      f32 quad_y[4] = {corner_y[0][lane], corner_y[1][lane], corner_y[2][lane], corner_y[3][lane]};
+      writeQuad(out, quad_x, quad_y, batch.z ? batch.z[i + lane] : 0.0f, batch.color[i + lane], tex_index);
+      out += 4;
+    }
+  }
+
+  quadKernelScalar(batch, i, end - i, tex_index, out);
+}
+
+/************** AVX2 + FMA, 8 quads per iteration *****
+##############################################################################
+*/
+
+__attribute__((target("avx2,fma"))) internal inline void sinCosDegrees8(__m256 deg, __m256 &sin_t, __m256 &cos_t) {
+  __m256i one = _mm256_set1_epi32(1);
+  __m256i two = _mm256_set1_epi32(2);
+
+  __m256 x = _mm256_mul_ps(deg, _mm256_set1_ps(Pi / 180));
+  __m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(2.0f / Pi)));
+  __m256 q = _mm256_cvtepi32_ps(quadrant);
+  __m256 r = _mm256_fnmadd_ps(q, _mm256_set1_ps(math::half_pi_1), x);
+  r = _mm256_fnmadd_ps(q, _mm256_set1_ps(math::half_pi_2), r);
+  r = _mm256_fnmadd_ps(q, _mm256_set1_ps(math::half_pi_3), r);
+  __m256 r2 = _mm256_mul_ps(r, r);
+
+  __m256 s = _mm256_fmadd_ps(r2, _mm256_set1_ps(math::sin_c2), _mm256_set1_ps(math::sin_c1));
+  s = _mm256_fmadd_ps(r2, s, _mm256_set1_ps(math::sin_c0));
+  s = _mm256_fmadd_ps(_mm256_mul_ps(r, r2), s, r);
+
+  __m256 c = _mm256_fmadd_ps(r2, _mm256_set1_ps(math::cos_c2), _mm256_set1_ps(math::cos_c1));
+  c = _mm256_fmadd_ps(r2, c, _mm256_set1_ps(math::cos_c0));
+  c = _mm256_fmadd_ps(_mm256_mul_ps(r2, r2), c, _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), r2, _mm256_set1_ps(1.0f)));
+
+  __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+  __m256 sin_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30));
+  __m256 cos_sign =
+      _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), two), 30));
+
+  sin_t = _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sin_sign);
+  cos_t = _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cos_sign);
+}
+
+__attribute__((target("avx2,fma"))) internal void quadKernelAVX2(const QuadBatch &batch, u32 first, u32 count,
+                                                                 f32 tex_index, QuadVertex *out) {
+  __m256 half = _mm256_set1_ps(0.5f);
+  u32 end = first + count;
+  u32 i = first;
+
+  for (; i + 8 <= end; i += 8) {
+    __m256 sin_t;
+    __m256 cos_t;
+    sinCosDegrees8(_mm256_loadu_ps(batch.angle + i), sin_t, cos_t);
+
+    __m256 half_w = _mm256_mul_ps(half, _mm256_loadu_ps(batch.width + i));
+    __m256 half_h = _mm256_mul_ps(half, _mm256_loadu_ps(batch.height + i));
+    __m256 a = _mm256_mul_ps(cos_t, half_w);
+    __m256 b = _mm256_mul_ps(sin_t, half_w);
+    __m256 d = _mm256_mul_ps(cos_t, half_h);
+    __m256 e = _mm256_mul_ps(sin_t, half_h);
+
+    __m256 x = _mm256_loadu_ps(batch.x + i);
+    __m256 y = _mm256_loadu_ps(batch.y + i);
+
+    alignas(32) f32 corner_x[4][8];
+    alignas(32) f32 corner_y[4][8];
+    _mm256_store_ps(corner_x[0], _mm256_add_ps(_mm256_sub_ps(x, a), e));
+    _mm256_store_ps(corner_x[1], _mm256_add_ps(_mm256_add_ps(x, a), e));
+    _mm256_store_ps(corner_x[2], _mm256_sub_ps(_mm256_add_ps(x, a), e));
+    _mm256_store_ps(corner_x[3], _mm256_sub_ps(_mm256_sub_ps(x, a), e));
+    _mm256_store_ps(corner_y[0], _mm256_sub_ps(_mm256_sub_ps(y, b), d));
+    _mm256_store_ps(corner_y[1], _mm256_sub_ps(_mm256_add_ps(y, b), d));
+    _mm256_store_ps(corner_y[2], _mm256_add_ps(_mm256_add_ps(y, b), d));
+    _mm256_store_ps(corner_y[3], _mm256_add_ps(_mm256_sub_ps(y, b), d));
+
+    for (u32 lane = 0; lane < 8; lane++) {
+      f32 quad_x[4] = {corner_x[0][lane], corner_x[1][lane], corner_x[2][lane], corner_x[3][lane]};
+      f32 quad_y[4] = {corner_y[0][lane], corner_y[1][lane], corner_y[2][lane], corner_y[3][lane]};
+      writeQuad(out, quad_x, quad_y, batch.z ? batch.z[i + lane] : 0.0f, batch.color[i + lane], tex_index);
+      out += 4;
+    }
+  }
+
+  quadKernelScalar(batch, i, end - i, tex_index, out);
+}
+
+internal QuadKernel *selectQuadKernel() {
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return quadKernelAVX2;
+  }
+
+  if (__builtin_cpu_supports("sse4.1")) {
+    return quadKernelSSE;
+  }
+
+  return quadKernelScalar;
+}
+
+// Picked on every load of the game library, so a hot reload never keeps a
+// pointer into the previous one
+global_var QuadKernel *quad_kernel = selectQuadKernel();
+
+// The instanced path needs no transform, only the SoA to QuadInstance repack
+internal void packQuadInstances(const QuadBatch &batch, u32 first, u32 count, f32 tex_index, QuadInstance *out) {
+  for (u32 i = first; i < first + count; i++) {
+    out->position = {batch.x[i], batch.y[i], batch.z ? batch.z[i] : 0.0f};
+    out->rotation = math::radians(batch.angle[i]);
+    out->size = {batch.width[i], batch.height[i]};
+    out->color = batch.color[i];
+    out->uv_rect = {0.0f, 0.0f, 1.0f, 1.0f};
+    out->tex_index = tex_index;
+    out++;
+  }
+}
+
+#endif
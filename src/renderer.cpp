@@ -6,6 +6,10 @@ inline void RendererCommands::drawIndexed(VertexArray *vertex_array, u32 count)
     renderer_api->drawIndexed(vertex_array, count);
 }
 
+inline void RendererCommands::drawIndexedInstanced(VertexArray *vertex_array, u32 index_count, u32 instance_count) {
+    renderer_api->drawIndexedInstanced(vertex_array, index_count, instance_count);
+}
+
 void Renderer::beginScene(Camera &camera) {
   scene.view_projection_mat = camera.view_projection_mat;
 }
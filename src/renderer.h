@@ -6,6 +6,21 @@ constexpr u32 max_quads = 3000;
 constexpr u32 max_vertices = max_quads * 4;
 constexpr u32 max_indices = max_quads * 6;
 constexpr u32 max_texture_slots = 16; // TODO: render settings. Could differ on other GPUs
+constexpr u32 max_render_commands = 32768; // Deferred quads per scene before an early sort and flush
+
+// 64-bit render sort key, most significant field first:
+//   63..56 layer
+//   55     translucent, opaque quads of a layer draw first
+//   54..52 shader
+//   51..0  opaque: texture (20 bits) then depth front to back (32 bits)
+//          translucent: depth back to front (32 bits) in the high end, the
+//          stable sort keeps submission order among equal depths
+constexpr u32 sort_key_layer_shift = 56;
+constexpr u32 sort_key_translucent_shift = 55;
+constexpr u32 sort_key_shader_shift = 52;
+constexpr u32 sort_key_texture_shift = 32;
+constexpr u32 sort_key_texture_mask = (1u << 20) - 1;
+constexpr u32 sort_key_translucent_depth_shift = 20;
 }; // namespace
 
 struct RendererCommands {
@@ -13,6 +28,7 @@ struct RendererCommands {
 
   void clear(v3 color);
   void drawIndexed(VertexArray *vertex_array, u32 count = 0);
+  void drawIndexedInstanced(VertexArray *vertex_array, u32 index_count, u32 instance_count);
 };
 
 struct QuadVertex {
@@ -22,19 +38,96 @@ struct QuadVertex {
   f32 tex_index;
 };
 
+// Structure of arrays input for Renderer2D::drawQuads, each array holds count entries
+struct QuadBatch {
+  u32 count;
+  const f32 *x;
+  const f32 *y;
+  const f32 *z; // optional, quads lie at depth 0 without it
+  const f32 *width;
+  const f32 *height;
+  const f32 *angle; // degrees
+  const v4 *color;
+};
+
+// One record per quad, the vertex shader expands a static unit quad from it
+struct QuadInstance {
+  v3 position;
+  f32 rotation; // radians
+  v2 size;
+  v4 color;
+  v4 uv_rect; // min uv in xy, max uv in zw
+  f32 tex_index;
+};
+
+enum class QuadPath : u8 {
+  Vertices,
+  Instanced
+};
+
+enum class QuadSubmission : u8 {
+  Immediate,
+  Sorted
+};
+
+// Payload of one deferred quad
+struct QuadCommand {
+  v3 position;
+  f32 angle;
+  v2 size;
+  TextureHandle texture;
+  v4 color;
+};
+
+struct RenderSortEntry {
+  u64 key;
+  u32 command;
+};
+
+// Deferred quads of the current scene, the arrays are allocated once in Renderer2D::init
+struct RenderQueue {
+  u32 count;
+  u32 capacity;
+  RenderSortEntry *entries;
+  RenderSortEntry *scratch;
+  QuadCommand *commands;
+
+  // Structure of arrays gather space for one run of sorted commands
+  f32 *x;
+  f32 *y;
+  f32 *z;
+  f32 *width;
+  f32 *height;
+  f32 *angle;
+  v4 *color;
+};
+
 struct Renderer2D_Data {
   VertexArray *quad_va;
   VertexBuffer *quad_vbo;
   Shader *texture_shader;
-  Texture *white_texture;
+  TextureHandle white_texture;
+  ResourceHeap *resource_heap;
 
   u32 quad_index_count = 0;
   QuadVertex *quad_buffer_base = nullptr;
   QuadVertex *quad_buffer_ptr = nullptr;
 
-  std::array<Texture *, max_texture_slots> texture_slots;
+  QuadPath quad_path = QuadPath::Instanced;
+  VertexArray *instance_va;
+  VertexBuffer *instance_vbo;
+  Shader *instance_shader;
+  u32 instance_count = 0;
+  QuadInstance *instance_buffer_base = nullptr;
+  QuadInstance *instance_buffer_ptr = nullptr;
+
+  QuadSubmission submission = QuadSubmission::Sorted;
+  RenderQueue queue;
+  u8 layer = 0;
+
+  std::array<TextureHandle, max_texture_slots> texture_slots;
   u32 texture_slot_index = 1;
-  
+
   v4 quad_vertices[4];
 };
 
@@ -44,11 +137,23 @@ struct Renderer2D {
   void beginScene(Camera &camera);
   void endScene();
   void flushAll();
+  void flushBatch();
+  void beginBatch();
+  void setLayer(u8 layer);
   void drawQuad(const v2 &pos, const v2 &size, f32 angle, const v4 &color);
   void drawQuad(const v3 &pos, const v2 &size, f32 angle, const v4 &color);
-  void drawQuad(const v2 &pos, const v2 &size, f32 angle, Texture *texture);
-  void drawQuad(const v3 &pos, const v2 &size, f32 angle, Texture *Texture);
-  
+  void drawQuad(const v2 &pos, const v2 &size, f32 angle, TextureHandle texture);
+  void drawQuad(const v3 &pos, const v2 &size, f32 angle, TextureHandle texture);
+  void drawQuads(const QuadBatch &batch);
+  void drawQuads(const QuadBatch &batch, TextureHandle texture);
+  void pushQuads(const QuadBatch &batch, TextureHandle texture);
+  void recordQuad(const v3 &pos, const v2 &size, f32 angle, const v4 &color, TextureHandle texture);
+  void submitCommands();
+  f32 textureIndex(TextureHandle texture);
+  void pushInstance(const v3 &pos, const v2 &size, f32 angle, const v4 &color, f32 tex_index);
+  template <bool Rotated>
+  void pushQuad(const v3 &pos, const v2 &size, f32 angle, const v4 &color, f32 tex_index);
+
   RendererCommands commands;
   Renderer2D_Data data;
 };
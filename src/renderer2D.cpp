@@ -1,21 +1,26 @@
 
+template <typename T>
+internal T *queueArray(Allocator *allocator, u32 count) {
+  T *result = reinterpret_cast<T *>(allocator->allocate(sizeof(T) * count, alignof(T) < 16 ? 16 : alignof(T)));
+  assert(result && "Not enough memory for the render queue");
+
+  return result;
+}
+
 void Renderer2D::init(RendererAPI *renderer_api, const MemoryStorage &memory) {
   data.quad_va = VertexArray::instance(renderer_api, memory);
   data.quad_va->create();
 
 
   data.quad_vbo = VertexBuffer::instance(renderer_api, memory);
-  data.quad_vbo->create(max_vertices * sizeof(QuadVertex));
+  data.quad_vbo->createStream(max_vertices * sizeof(QuadVertex));
 
-  std::vector<Element> layout = {
-      {Float3, "a_Position"}, {Float4, "a_Color"}, {Float2, "a_TexCoord"}, {Float, "a_TexIndex"}};
+  Element layout[] = {{Float3, "a_Position"}, {Float4, "a_Color"}, {Float2, "a_TexCoord"}, {Float, "a_TexIndex"}};
 
-  data.quad_vbo->setLayout(layout);
+  data.quad_vbo->setLayout(layout, ARRAY_LEN(layout));
   data.quad_va->addBuffer(data.quad_vbo);
 
-  data.quad_buffer_base = alloc_array<QuadVertex, max_vertices>(memory.resource_partition);
-
-  u32 *quad_indices = alloc_array<u32, max_indices>(memory.resource_partition);
+  u32 *quad_indices = alloc_array<u32, max_indices>(memory.tagged(MemoryTag::Renderer));
 
   u32 offset = 0;
   for (u32 i = 0; i < max_indices; i += 6) {
@@ -33,7 +38,34 @@ void Renderer2D::init(RendererAPI *renderer_api, const MemoryStorage &memory) {
   IndexBuffer *quad_ibo = IndexBuffer::instance(renderer_api, memory);
   quad_ibo->create(quad_indices, max_indices);
   data.quad_va->setIndexBuffer(quad_ibo);
-  dealloc_array<u32>(memory.resource_partition, quad_indices);
+  dealloc_array<u32>(memory.tagged(MemoryTag::Renderer), quad_indices);
+
+  // Instanced path: a static unit quad plus one QuadInstance per drawn quad
+  data.instance_va = VertexArray::instance(renderer_api, memory);
+  data.instance_va->create();
+
+  f32 unit_quad[] = {-0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f};
+  VertexBuffer *unit_quad_vbo = VertexBuffer::instance(renderer_api, memory);
+  unit_quad_vbo->create(unit_quad, sizeof(unit_quad));
+
+  Element unit_quad_layout[] = {{Float2, "a_Corner"}};
+  unit_quad_vbo->setLayout(unit_quad_layout, ARRAY_LEN(unit_quad_layout));
+  data.instance_va->addBuffer(unit_quad_vbo);
+
+  data.instance_vbo = VertexBuffer::instance(renderer_api, memory);
+  data.instance_vbo->createStream(max_quads * sizeof(QuadInstance));
+  data.instance_vbo->divisor = 1;
+
+  Element instance_layout[] = {{Float3, "i_Position"}, {Float, "i_Rotation"}, {Float2, "i_Size"},
+                               {Float4, "i_Color"},    {Float4, "i_UVRect"}, {Float, "i_TexIndex"}};
+
+  data.instance_vbo->setLayout(instance_layout, ARRAY_LEN(instance_layout));
+  data.instance_va->addBuffer(data.instance_vbo);
+
+  u32 unit_quad_indices[] = {0, 1, 2, 2, 3, 0};
+  IndexBuffer *unit_quad_ibo = IndexBuffer::instance(renderer_api, memory);
+  unit_quad_ibo->create(unit_quad_indices, ARRAY_LEN(unit_quad_indices));
+  data.instance_va->setIndexBuffer(unit_quad_ibo);
 
   const char *texture_vertex = "#version 410 core\n"
                                "layout (location = 0) in vec3 a_Position;\n"
@@ -63,11 +95,37 @@ void Renderer2D::init(RendererAPI *renderer_api, const MemoryStorage &memory) {
                                  "color = texture(u_Textures[int(v_TexIndex)], v_TexCoord) * v_Color;\n"
                                  "}\n\0";
 
+  const char *instance_vertex = "#version 410 core\n"
+                                "layout (location = 0) in vec2 a_Corner;\n"
+                                "layout (location = 1) in vec3 i_Position;\n"
+                                "layout (location = 2) in float i_Rotation;\n"
+                                "layout (location = 3) in vec2 i_Size;\n"
+                                "layout (location = 4) in vec4 i_Color;\n"
+                                "layout (location = 5) in vec4 i_UVRect;\n"
+                                "layout (location = 6) in float i_TexIndex;\n"
+                                "uniform mat4 u_ViewProjection;\n"
+                                "out vec4 v_Color;\n"
+                                "out vec2 v_TexCoord;\n"
+                                "out float v_TexIndex;\n"
+                                "void main()\n"
+                                "{\n"
+                                "vec2 local = a_Corner * i_Size;\n"
+                                "float s = sin(i_Rotation);\n"
+                                "float c = cos(i_Rotation);\n"
+                                "vec3 position = i_Position + vec3(c * local.x - s * local.y, s * local.x + c * local.y, 0.0);\n"
+                                "v_Color = i_Color;\n"
+                                "v_TexCoord = mix(i_UVRect.xy, i_UVRect.zw, a_Corner + 0.5);\n"
+                                "v_TexIndex = i_TexIndex;\n"
+                                "gl_Position = vec4(position, 1.0) * u_ViewProjection;\n"
+                                "}\n\0";
+
+  data.resource_heap = memory.resource_heap;
   data.white_texture = Texture::instance(renderer_api, memory);
-  data.white_texture->create(1, 1);
+  Texture *white_texture = data.resource_heap->get<Texture>(data.white_texture);
+  white_texture->create(1, 1);
 
   u32 white_texture_data = 0xFFFFFFFF;
-  data.white_texture->setData(&white_texture_data, sizeof(u32));
+  white_texture->setData(&white_texture_data, sizeof(u32));
 
   i32 samplers[max_texture_slots];
   for (u32 i = 0; i < max_texture_slots; i++) {
@@ -79,152 +137,396 @@ void Renderer2D::init(RendererAPI *renderer_api, const MemoryStorage &memory) {
   data.texture_shader->bind();
   data.texture_shader->uploadArrayi("u_Textures", samplers, max_texture_slots);
 
+  data.instance_shader = Shader::instance(renderer_api, memory);
+  data.instance_shader->createProgram(instance_vertex, texture_fragment);
+  data.instance_shader->bind();
+  data.instance_shader->uploadArrayi("u_Textures", samplers, max_texture_slots);
+
   data.texture_slots[0] = data.white_texture;
 
   data.quad_vertices[0] = {-0.5f, -0.5f, 0.0f, 1.0f};
   data.quad_vertices[1] = {0.5f, -0.5f, 0.0f, 1.0f};
   data.quad_vertices[2] = {0.5f, 0.5f, 0.0f, 1.0f};
   data.quad_vertices[3] = {-0.5f, 0.5f, 0.0f, 1.0f};
+
+  ProxyAllocator *allocator = memory.tagged(MemoryTag::Renderer);
+  RenderQueue &queue = data.queue;
+  queue.count = 0;
+  queue.capacity = max_render_commands;
+  queue.entries = queueArray<RenderSortEntry>(allocator, queue.capacity);
+  queue.scratch = queueArray<RenderSortEntry>(allocator, queue.capacity);
+  queue.commands = queueArray<QuadCommand>(allocator, queue.capacity);
+  queue.x = queueArray<f32>(allocator, queue.capacity);
+  queue.y = queueArray<f32>(allocator, queue.capacity);
+  queue.z = queueArray<f32>(allocator, queue.capacity);
+  queue.width = queueArray<f32>(allocator, queue.capacity);
+  queue.height = queueArray<f32>(allocator, queue.capacity);
+  queue.angle = queueArray<f32>(allocator, queue.capacity);
+  queue.color = queueArray<v4>(allocator, queue.capacity);
 }
 
 void Renderer2D::beginScene(Camera &camera) {
   TIMED_BLOCK("Renderer2D::beginScene");
 
+  data.instance_shader->bind();
+  data.instance_shader->uploadMat4("u_ViewProjection", camera.view_projection_mat);
+
   data.texture_shader->bind();
   data.texture_shader->uploadMat4("u_ViewProjection", camera.view_projection_mat);
 
-  data.quad_index_count = 0;
-
-  data.quad_buffer_ptr = data.quad_buffer_base;
+  beginBatch();
   data.texture_slot_index = 1;
+  data.queue.count = 0;
+}
+
+// Quads are written straight into the streaming buffer of the active path
+void Renderer2D::beginBatch() {
+  data.quad_index_count = 0;
+  data.instance_count = 0;
+
+  if (data.quad_path == QuadPath::Instanced) {
+    data.instance_buffer_base = reinterpret_cast<QuadInstance *>(data.instance_vbo->beginWrite());
+    data.instance_buffer_ptr = data.instance_buffer_base;
+  } else {
+    data.quad_buffer_base = reinterpret_cast<QuadVertex *>(data.quad_vbo->beginWrite());
+    data.quad_buffer_ptr = data.quad_buffer_base;
+  }
 }
 
 void Renderer2D::endScene() {
   TIMED_BLOCK("Renderer2D::endScene");
 
-  u32 data_size = reinterpret_cast<u8 *>(data.quad_buffer_ptr) - reinterpret_cast<u8 *>(data.quad_buffer_base);
-  data.quad_vbo->setData(data.quad_buffer_base, data_size);
+  if (data.submission == QuadSubmission::Sorted) {
+    submitCommands();
+  }
+
+  flushBatch();
+}
 
+void Renderer2D::flushBatch() {
   for (u32 i = 0; i < data.texture_slot_index; i++) {
-    data.texture_slots[i]->bind(i);
+    data.resource_heap->get<Texture>(data.texture_slots[i])->bind(i);
   }
 
-  commands.drawIndexed(data.quad_va, data.quad_index_count);
+  if (data.quad_path == QuadPath::Instanced) {
+    size_t offset = data.instance_vbo->endWrite(data.instance_count * sizeof(QuadInstance));
+    data.instance_va->setBufferOffset(data.instance_vbo, offset);
+
+    data.instance_shader->bind();
+    commands.drawIndexedInstanced(data.instance_va, 6, data.instance_count);
+  } else {
+    u32 data_size = reinterpret_cast<u8 *>(data.quad_buffer_ptr) - reinterpret_cast<u8 *>(data.quad_buffer_base);
+    size_t offset = data.quad_vbo->endWrite(data_size);
+    data.quad_va->setBufferOffset(data.quad_vbo, offset);
+
+    data.texture_shader->bind();
+    data.quad_va->bind();
+    commands.drawIndexed(data.quad_va, data.quad_index_count);
+  }
   DEBUG_PRINT("%s\n","draw call");
 }
 
 void Renderer2D::flushAll() {
-  endScene();
-
-  data.quad_index_count = 0;
-  data.quad_buffer_ptr = data.quad_buffer_base;
+  flushBatch();
+  beginBatch();
 
   data.texture_slot_index = 1;
 }
 
+f32 Renderer2D::textureIndex(TextureHandle texture) {
+  if (texture == data.white_texture) {
+    return 0.0f;
+  }
+
+  for (u32 i = 1; i < data.texture_slot_index; i++) {
+    if (data.texture_slots[i] == texture) {
+      return static_cast<f32>(i);
+    }
+  }
+
+  if (data.texture_slot_index >= max_texture_slots) {
+    flushAll();
+  }
+
+  f32 tex_index = static_cast<f32>(data.texture_slot_index);
+  data.texture_slots[data.texture_slot_index] = texture;
+  data.texture_slot_index++;
+
+  return tex_index;
+}
+
+void Renderer2D::pushInstance(const v3 &pos, const v2 &size, f32 angle, const v4 &color, f32 tex_index) {
+  data.instance_buffer_ptr->position = pos;
+  data.instance_buffer_ptr->rotation = math::radians(angle);
+  data.instance_buffer_ptr->size = size;
+  data.instance_buffer_ptr->color = color;
+  data.instance_buffer_ptr->uv_rect = {0.0f, 0.0f, 1.0f, 1.0f};
+  data.instance_buffer_ptr->tex_index = tex_index;
+  data.instance_buffer_ptr++;
+
+  data.instance_count++;
+}
+
+// Axis-aligned quads skip the trig and matrix work entirely, see quadCorners
+template <bool Rotated>
+void Renderer2D::pushQuad(const v3 &pos, const v2 &size, f32 angle, const v4 &color, f32 tex_index) {
+  f32 corner_x[4];
+  f32 corner_y[4];
+  quadCorners<Rotated>(pos.x, pos.y, size.x, size.y, angle, corner_x, corner_y);
+
+  writeQuad(data.quad_buffer_ptr, corner_x, corner_y, pos.z, color, tex_index);
+  data.quad_buffer_ptr += 4;
+
+  data.quad_index_count += 6;
+}
+
 void Renderer2D::drawQuad(const v2 &pos, const v2 &size, f32 angle, const v4 &color) {
   drawQuad({pos.x, pos.y, 0.0f}, size, angle, color);
 }
 
 void Renderer2D::drawQuad(const v3 &pos, const v2 &size, f32 angle, const v4 &color) {
+  if (data.submission == QuadSubmission::Sorted) {
+    recordQuad(pos, size, angle, color, data.white_texture);
+    return;
+  }
+
+  if (data.quad_path == QuadPath::Instanced) {
+    if (data.instance_count >= max_quads) {
+      flushAll();
+    }
 
-  if (data.quad_index_count >= max_quads) {
+    pushInstance(pos, size, angle, color, 0.0f);
+    return;
+  }
+
+  if (data.quad_index_count >= max_indices) {
     flushAll();
   }
 
-  f32 tex_index = 0.0f; // white texture
+  if (angle == 0.0f) {
+    pushQuad<false>(pos, size, angle, color, 0.0f);
+  } else {
+    pushQuad<true>(pos, size, angle, color, 0.0f);
+  }
+}
 
-  Mat4x4 tran;
-  tran = translate(pos) * rotZ(angle) * scale({size.x, size.y, 0.0f});
+void Renderer2D::drawQuad(const v2 &pos, const v2 &size, f32 angle, TextureHandle texture) {
+  drawQuad({pos.x, pos.y, 0.0f}, size, angle, texture);
+}
 
-  data.quad_buffer_ptr->position = tran * data.quad_vertices[0];
-  data.quad_buffer_ptr->color = color;
-  data.quad_buffer_ptr->tex_coord = {0.0f, 0.0f};
-  data.quad_buffer_ptr->tex_index = tex_index;
-  data.quad_buffer_ptr++;
+void Renderer2D::drawQuad(const v3 &pos, const v2 &size, f32 angle, TextureHandle texture) {
+  v4 color = {1.0f, 1.0f, 1.0f, 1.0f};
 
-  data.quad_buffer_ptr->position = tran * data.quad_vertices[1];
-  data.quad_buffer_ptr->color = color;
-  data.quad_buffer_ptr->tex_coord = {1.0f, 0.0f};
-  data.quad_buffer_ptr->tex_index = tex_index;
-  data.quad_buffer_ptr++;
+  if (data.submission == QuadSubmission::Sorted) {
+    recordQuad(pos, size, angle, color, texture);
+    return;
+  }
 
-  data.quad_buffer_ptr->position = tran * data.quad_vertices[2];
-  data.quad_buffer_ptr->color = color;
-  data.quad_buffer_ptr->tex_coord = {1.0f, 1.0f};
-  data.quad_buffer_ptr->tex_index = tex_index;
-  data.quad_buffer_ptr++;
+  if (data.quad_path == QuadPath::Instanced) {
+    if (data.instance_count >= max_quads) {
+      flushAll();
+    }
 
-  data.quad_buffer_ptr->position = tran * data.quad_vertices[3];
-  data.quad_buffer_ptr->color = color;
-  data.quad_buffer_ptr->tex_coord = {0.0f, 1.0f};
-  data.quad_buffer_ptr->tex_index = tex_index;
-  data.quad_buffer_ptr++;
+    pushInstance(pos, size, angle, color, textureIndex(texture));
+    return;
+  }
 
-  data.quad_index_count += 6;
+  if (data.quad_index_count >= max_indices) {
+    flushAll();
+  }
+
+  f32 tex_index = textureIndex(texture);
+
+  if (angle == 0.0f) {
+    pushQuad<false>(pos, size, angle, color, tex_index);
+  } else {
+    pushQuad<true>(pos, size, angle, color, tex_index);
+  }
 }
 
-void Renderer2D::drawQuad(const v2 &pos, const v2 &size, f32 angle, Texture *texture) {
-  drawQuad({pos.x, pos.y, 0.0f}, size, angle, texture);
+void Renderer2D::drawQuads(const QuadBatch &batch) {
+  drawQuads(batch, data.white_texture);
 }
 
-void Renderer2D::drawQuad(const v3 &pos, const v2 &size, f32 angle, Texture *texture) {
+void Renderer2D::drawQuads(const QuadBatch &batch, TextureHandle texture) {
+  TIMED_BLOCK("Renderer2D::drawQuads");
 
-  if (data.quad_index_count >= max_quads) {
-    flushAll();
+  if (data.submission == QuadSubmission::Sorted) {
+    for (u32 i = 0; i < batch.count; i++) {
+      v3 pos = {batch.x[i], batch.y[i], batch.z ? batch.z[i] : 0.0f};
+      recordQuad(pos, {batch.width[i], batch.height[i]}, batch.angle[i], batch.color[i], texture);
+    }
+    return;
   }
 
-  v4 color = {1.0f, 1.0f, 1.0f, 1.0f};
-  f32 tex_index = 0.0f;
-  for (u32 i = 1; i < data.texture_slot_index; i++) {
-    if (*(data.texture_slots[i]) == *texture) {
-      tex_index = static_cast<f32>(i);
-      break;
+  pushQuads(batch, texture);
+}
+
+void Renderer2D::pushQuads(const QuadBatch &batch, TextureHandle texture) {
+  u32 first = 0;
+  while (first < batch.count) {
+    if (data.quad_path == QuadPath::Instanced) {
+      if (data.instance_count >= max_quads) {
+        flushAll();
+      }
+
+      // Resolved before the room is measured, it may flush on its own
+      f32 tex_index = textureIndex(texture);
+      u32 count = std::min(batch.count - first, max_quads - data.instance_count);
+
+      packQuadInstances(batch, first, count, tex_index, data.instance_buffer_ptr);
+      data.instance_buffer_ptr += count;
+      data.instance_count += count;
+      first += count;
+    } else {
+      if (data.quad_index_count >= max_indices) {
+        flushAll();
+      }
+
+      f32 tex_index = textureIndex(texture);
+      u32 count = std::min(batch.count - first, max_quads - data.quad_index_count / 6);
+
+      quad_kernel(batch, first, count, tex_index, data.quad_buffer_ptr);
+      data.quad_buffer_ptr += count * 4;
+      data.quad_index_count += count * 6;
+      first += count;
     }
   }
+}
 
-  if (tex_index == 0.0f) {
-    if (data.texture_slot_index >= max_texture_slots) {
-      flushAll();
+void Renderer2D::setLayer(u8 layer) { data.layer = layer; }
+
+// Orders float depths as unsigned integers, negative values included
+internal u32 sortableDepth(f32 depth) {
+  u32 bits;
+  memcpy(&bits, &depth, sizeof(bits));
+
+  return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+// Larger z is nearer the camera, see ortho in Camera. Opaque quads go front to
+// back within a texture so early depth rejects hidden fragments, translucent
+// ones back to front so blending composes in the right order.
+internal u64 renderSortKey(u8 layer, b32 translucent, u8 shader, TextureHandle texture, f32 depth) {
+  u64 key = static_cast<u64>(layer) << sort_key_layer_shift;
+  key |= static_cast<u64>(shader & 0x7) << sort_key_shader_shift;
+
+  if (translucent) {
+    key |= 1ull << sort_key_translucent_shift;
+    key |= static_cast<u64>(sortableDepth(depth)) << sort_key_translucent_depth_shift;
+  } else {
+    key |= static_cast<u64>(texture.index & sort_key_texture_mask) << sort_key_texture_shift;
+    key |= ~sortableDepth(depth);
+  }
+
+  return key;
+}
+
+// LSD radix sort on 8 bit digits. Stable, and digits every key shares are
+// skipped, so the usual handful of layers and textures costs a few passes.
+internal RenderSortEntry *sortRenderEntries(RenderSortEntry *entries, RenderSortEntry *scratch, u32 count) {
+  u32 histograms[8][256] = {};
+  for (u32 i = 0; i < count; i++) {
+    u64 key = entries[i].key;
+    for (u32 digit = 0; digit < 8; digit++) {
+      histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+    }
+  }
+
+  RenderSortEntry *source = entries;
+  RenderSortEntry *destination = scratch;
+  for (u32 digit = 0; digit < 8; digit++) {
+    u32 *histogram = histograms[digit];
+    u32 shift = digit * 8;
+    if (count == 0 || histogram[(source[0].key >> shift) & 0xFF] == count) {
+      continue;
+    }
+
+    u32 offset = 0;
+    for (u32 bucket = 0; bucket < 256; bucket++) {
+      u32 bucket_count = histogram[bucket];
+      histogram[bucket] = offset;
+      offset += bucket_count;
     }
 
-    tex_index = static_cast<f32>(data.texture_slot_index);
-    data.texture_slots[data.texture_slot_index] = texture;
-    data.texture_slot_index++;
+    for (u32 i = 0; i < count; i++) {
+      destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+    }
+
+    std::swap(source, destination);
   }
 
-  Mat4x4 tran;
-  tran = translate(pos) * rotZ(angle) * scale({size.x, size.y, 1.0f});
+  return source;
+}
 
-  data.quad_buffer_ptr->position = tran * data.quad_vertices[0];
-  data.quad_buffer_ptr->color = color;
-  data.quad_buffer_ptr->tex_coord = {0.0f, 0.0f};
-  data.quad_buffer_ptr->tex_index = tex_index;
-  data.quad_buffer_ptr++;
+void Renderer2D::recordQuad(const v3 &pos, const v2 &size, f32 angle, const v4 &color, TextureHandle texture) {
+  RenderQueue &queue = data.queue;
+  if (queue.count == queue.capacity) {
+    submitCommands();
+  }
 
-  data.quad_buffer_ptr->position = tran * data.quad_vertices[1];
-  data.quad_buffer_ptr->color = color;
-  data.quad_buffer_ptr->tex_coord = {1.0f, 0.0f};
-  data.quad_buffer_ptr->tex_index = tex_index;
-  data.quad_buffer_ptr++;
+  u32 index = queue.count++;
+  queue.commands[index] = {pos, angle, size, texture, color};
 
-  data.quad_buffer_ptr->position = tran * data.quad_vertices[2];
-  data.quad_buffer_ptr->color = color;
-  data.quad_buffer_ptr->tex_coord = {1.0f, 1.0f};
-  data.quad_buffer_ptr->tex_index = tex_index;
-  data.quad_buffer_ptr++;
+  b32 translucent = color.w < 1.0f;
+  if (!translucent && texture != data.white_texture) {
+    translucent = data.resource_heap->get<Texture>(texture)->translucent;
+  }
 
-  data.quad_buffer_ptr->position = tran * data.quad_vertices[3];
-  data.quad_buffer_ptr->color = color;
-  data.quad_buffer_ptr->tex_coord = {0.0f, 1.0f};
-  data.quad_buffer_ptr->tex_index = tex_index;
-  data.quad_buffer_ptr++;
+  u8 shader = static_cast<u8>(data.quad_path);
+  queue.entries[index] = {renderSortKey(data.layer, translucent, shader, texture, pos.z), index};
+}
 
-  data.quad_index_count += 6;
+// Sorts the recorded quads and hands each run that shares a texture to
+// pushQuads, so a batch only breaks when it is full or out of texture slots
+void Renderer2D::submitCommands() {
+  TIMED_BLOCK("Renderer2D::submitCommands");
+
+  RenderQueue &queue = data.queue;
+  RenderSortEntry *sorted = sortRenderEntries(queue.entries, queue.scratch, queue.count);
+
+  u32 run_start = 0;
+  while (run_start < queue.count) {
+    TextureHandle texture = queue.commands[sorted[run_start].command].texture;
+
+    u32 run_count = 0;
+    for (u32 i = run_start; i < queue.count; i++) {
+      const QuadCommand &command = queue.commands[sorted[i].command];
+      if (command.texture != texture) {
+        break;
+      }
+
+      queue.x[run_count] = command.position.x;
+      queue.y[run_count] = command.position.y;
+      queue.z[run_count] = command.position.z;
+      queue.width[run_count] = command.size.x;
+      queue.height[run_count] = command.size.y;
+      queue.angle[run_count] = command.angle;
+      queue.color[run_count] = command.color;
+      run_count++;
+    }
+
+    QuadBatch batch = {run_count, queue.x, queue.y, queue.z, queue.width, queue.height, queue.angle, queue.color};
+    pushQuads(batch, texture);
+
+    run_start += run_count;
+  }
+
+  queue.count = 0;
 }
 
 // TODO: Determine when it needs to be called
 void Renderer2D::destroy(const MemoryStorage &memory) {
-  dealloc<VertexArray>(memory.resource_partition, data.quad_va);
-  dealloc<Shader>(memory.resource_partition, data.texture_shader);
+  dealloc<VertexArray>(memory.tagged(MemoryTag::Renderer), data.quad_va);
+  dealloc<Shader>(memory.tagged(MemoryTag::Renderer), data.texture_shader);
+  dealloc<VertexArray>(memory.tagged(MemoryTag::Renderer), data.instance_va);
+  dealloc<Shader>(memory.tagged(MemoryTag::Renderer), data.instance_shader);
+
+  ProxyAllocator *allocator = memory.tagged(MemoryTag::Renderer);
+  RenderQueue &queue = data.queue;
+  void *queue_arrays[] = {queue.entries, queue.scratch, queue.commands, queue.x,     queue.y,
+                          queue.z,       queue.width,   queue.height,   queue.angle, queue.color};
+  for (void *queue_array : queue_arrays) {
+    allocator->deallocate(queue_array);
+  }
 }
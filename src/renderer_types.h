@@ -3,6 +3,8 @@
 
 struct RendererAPI;
 
+typedef ResourceHandle TextureHandle;
+
 enum ShaderDataType {
     None = 0,
     Float,
@@ -87,7 +89,9 @@ u32 Element::getComponentCount() const {
 }
 
 struct VertexBuffer {
-    std::vector<Element> elements;
+    Array<Element> elements;
+    // Attributes advance once per this many instances, 0 means per vertex
+    u32 divisor = 0;
 
     static VertexBuffer *instance(RendererAPI *renderer_api,
 				  const MemoryStorage &memory);
@@ -97,9 +101,17 @@ struct VertexBuffer {
     virtual inline void bind() = 0;
     virtual inline void unbind() = 0;
     virtual void setData(const void *data, u32 size) = 0;
-    virtual void setLayout(std::vector<Element> elements) = 0;
+    virtual void setLayout(const Element *layout, u32 count) = 0;
     virtual u32 getStride() = 0;
 
+    // Streaming buffers hand every batch the next batch_size bytes of the
+    // current frame's segment. The batch is written at the pointer from
+    // beginWrite, endWrite returns its byte offset in the buffer. Segments are
+    // fenced and rotated once per frame by RendererAPI::endFrame.
+    virtual void createStream(u32 batch_size) = 0;
+    virtual void *beginWrite() = 0;
+    virtual size_t endWrite(u32 size) = 0;
+
     virtual ~VertexBuffer() = default;
 };
 
@@ -121,6 +133,8 @@ struct VertexArray {
     virtual void create() = 0;
     virtual void setIndexBuffer(IndexBuffer *buffer) = 0;
     virtual void addBuffer(VertexBuffer *buffer) = 0;
+    // Points the attributes of an added buffer at offset bytes into it
+    virtual void setBufferOffset(VertexBuffer *buffer, size_t offset) = 0;
 
     virtual inline void bind() = 0;
     virtual inline void unbind() = 0;
@@ -145,9 +159,10 @@ struct Shader {
     virtual ~Shader() = default;
 };
 
+// Textures live in the relocatable resource heap, so they are held by handle
 struct Texture {
-    static Texture *instance(RendererAPI *renderer_api,
-			     const MemoryStorage &memory);
+    static TextureHandle instance(RendererAPI *renderer_api,
+				  const MemoryStorage &memory);
 
     virtual void create(const char *path) = 0;
     virtual void create(u32 width, u32 height) = 0;
@@ -156,6 +171,9 @@ struct Texture {
     virtual void setData(void *data, u32 size) = 0;
     virtual bool operator==(const Texture &other) = 0;
     virtual ~Texture() = default;
+
+    // Set when a texel is not fully opaque, quads using it sort as translucent
+    b32 translucent = false;
 };
 
 class RendererAPI {
@@ -166,6 +184,10 @@ class RendererAPI {
     virtual void *getContext() = 0;
     virtual void clear(v3 color) = 0;
     virtual void drawIndexed(VertexArray *vertex_array, u32 count = 0) = 0;
+    virtual void drawIndexedInstanced(VertexArray *vertex_array,
+				      u32 index_count, u32 instance_count) = 0;
+    // Called by the platform after the game has drawn the frame, before the swap
+    virtual void endFrame() = 0;
     virtual ~RendererAPI() {}
 
    protected:
@@ -1,7 +1,9 @@
 
 #include <assert.h>
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 
 #include "os_platform.h"
@@ -16,6 +18,14 @@
 #define SDL_JOYSTICK_AXIS_MAX 32767
 #endif
 
+// Game memory backing. Prefaulting the whole block moves the page faults to startup
+// at the price of making all of it resident right away.
+#define GAME_MEMORY_HUGE_PAGES 1
+#define GAME_MEMORY_PREFAULT 0
+
+// Bytes the resource heap may move per frame while defragmenting
+#define RESOURCE_HEAP_COMPACT_BUDGET KB(256)
+
 #define MAX_CONTROLLERS 4
 #define CONTROLLER_AXIS_LEFT_DEADZONE 7849
 
@@ -106,6 +116,10 @@ internal void SDLx_ProcessEvents(SDLx_State &state, GameControllerInput *keyboar
           SDLx_ProcessKeyboardEvent(&keyboard->back, is_down);
         } else if (key_code == SDLK_RETURN) {
           SDLx_ProcessKeyboardEvent(&keyboard->start, is_down);
+        } else if (key_code == SDLK_F5) {
+          state.snapshot_requested |= is_down;
+        } else if (key_code == SDLK_F9) {
+          state.restore_requested |= is_down;
         } else if ((key_code == SDLK_ESCAPE) || (key_code == SDLK_LSHIFT) || (key_code == SDLK_RSHIFT)) {
           b32 either_down = (SDL_GetKeyboardState(0)[SDL_SCANCODE_SPACE] || (SDL_GetModState() & KMOD_SHIFT));
           keyboard->clutch_max = (either_down ? 1.0f : 0.0f);
@@ -160,21 +174,268 @@ internal f32 SDLx_GetSecondsElapsed(u64 start, u64 end) {
   return result;
 }
 
-internal void initializeGameSystems(GameRoot &game_root, SDLx_State &state) {
-  state.total_size = GB(1) + MB(160);
-  void *game_memory_block = mmap(0, state.total_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-  assert(game_memory_block != MAP_FAILED);
+internal u64 SDLx_GetPageFaultCount() {
+  struct rusage usage = {};
+  getrusage(RUSAGE_SELF, &usage);
 
-  state.game_memory_block = game_memory_block;
+  return static_cast<u64>(usage.ru_minflt + usage.ru_majflt);
+}
+
+/************** Game memory snapshots *****
+########################################################################################################################
+*/
+
+// Bits of a /proc/self/pagemap entry
+global_var const u64 pagemap_soft_dirty = 1ull << 55;
+global_var const u64 pagemap_swapped = 1ull << 62;
+global_var const u64 pagemap_present = 1ull << 63;
+
+internal void SDLx_ClearSoftDirty() {
+  int fd = open("/proc/self/clear_refs", O_WRONLY);
+  if (fd != -1) {
+    ssize_t written = write(fd, "4", 1);
+    (void)written;
+    close(fd);
+  }
+}
+
+// Calls fn(offset, bytes) for every run of pages in [offset, offset + size) of the block whose pagemap
+// entry has any of the mask bits set
+template <typename F>
+internal void SDLx_ForEachPageRun(int pagemap_fd, void *block, size_t offset, size_t size, u64 mask, F &&fn) {
+  size_t page_size = memory::pageSize();
+  size_t first_page = reinterpret_cast<uintptr_t>(memory::add(block, offset)) / page_size;
+  size_t page_count = size / page_size;
+
+  u64 entries[512];
+  size_t run_start = 0;
+  size_t run_pages = 0;
+  for (size_t page = 0; page < page_count; page += ARRAY_LEN(entries)) {
+    size_t count = page_count - page < ARRAY_LEN(entries) ? page_count - page : ARRAY_LEN(entries);
+    ssize_t bytes_read =
+        pread(pagemap_fd, entries, count * sizeof(u64), static_cast<off_t>((first_page + page) * sizeof(u64)));
+    if (bytes_read != static_cast<ssize_t>(count * sizeof(u64))) {
+      // pagemap not readable, treat the rest of the range as dirty
+      for (size_t i = 0; i < count; ++i) {
+        entries[i] = mask;
+      }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+      if (entries[i] & mask) {
+        if (!run_pages) {
+          run_start = offset + (page + i) * page_size;
+        }
+        ++run_pages;
+      } else if (run_pages) {
+        fn(run_start, run_pages * page_size);
+        run_pages = 0;
+      }
+    }
+  }
+
+  if (run_pages) {
+    fn(run_start, run_pages * page_size);
+  }
+}
 
-  // TODO: allocate these in the some partition instead of new
+b32 SDLx_Snapshot::init(SDLx_State &state) {
+  fd = -1;
+  pagemap_fd = -1;
+#ifdef MFD_CLOEXEC
+  fd = memfd_create("firewood_snapshot", MFD_CLOEXEC);
+#endif
+  if (fd == -1) {
+    char snapshot_path[SDL_PATH_MAX];
+    state.buildEXEFileName("game_snapshot.bin", sizeof(snapshot_path), snapshot_path);
+    fd = open(snapshot_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  }
 
-  auto game_partition = new LinearAllocator(MB(16), memory::add(game_memory_block, MB(16)));
-  auto resource_partition = new StackAllocator(GB(1), game_memory_block);
+  if (fd == -1 || ftruncate(fd, static_cast<off_t>(state.total_size)) != 0) {
+    fprintf(stderr, "Snapshot: cannot create backing storage\n");
+    return false;
+  }
+
+  data = mmap(0, state.total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "Snapshot: cannot map backing storage\n");
+    data = nullptr;
+    return false;
+  }
+
+  // Soft-dirty bits need CONFIG_MEM_SOFT_DIRTY. Without them every snapshot and restore copies
+  // the whole committed range.
+  pagemap_fd = open("/proc/self/pagemap", O_RDONLY);
+  soft_dirty_tracking = false;
+  if (pagemap_fd != -1) {
+    SDLx_ClearSoftDirty();
+    volatile u8 *probe = reinterpret_cast<volatile u8 *>(state.game_memory_block);
+    probe[0] = probe[0];
+
+    u64 entry = 0;
+    off_t entry_offset =
+        static_cast<off_t>(reinterpret_cast<uintptr_t>(state.game_memory_block) / memory::pageSize() * sizeof(u64));
+    if (pread(pagemap_fd, &entry, sizeof(entry), entry_offset) == sizeof(entry)) {
+      soft_dirty_tracking = (entry & pagemap_soft_dirty) != 0;
+    }
+  }
+
+  valid = false;
+  game_committed_size = 0;
+
+  return true;
+}
+
+void SDLx_Snapshot::take(SDLx_State &state, VirtualAllocator *game_partition) {
+  u64 start_counter = SDL_GetPerformanceCounter();
+  void *block = state.game_memory_block;
+  size_t copied = 0;
+  auto copy_out = [&](size_t offset, size_t bytes) {
+    memcpy(memory::add(data, offset), memory::add(block, offset), bytes);
+    copied += bytes;
+  };
+
+  // The first snapshot copies every page the process has touched, later ones only what was
+  // written since the previous snapshot or restore
+  u64 mask = (valid && soft_dirty_tracking) ? pagemap_soft_dirty : (pagemap_present | pagemap_swapped);
+  size_t committed_size = game_partition->committed_size;
+  if (pagemap_fd != -1) {
+    SDLx_ForEachPageRun(pagemap_fd, block, 0, state.fixed_size, mask, copy_out);
+    if (committed_size == game_committed_size) {
+      SDLx_ForEachPageRun(pagemap_fd, block, state.fixed_size, committed_size, mask, copy_out);
+    } else {
+      copy_out(state.fixed_size, committed_size);
+    }
+  } else {
+    copy_out(0, state.fixed_size + committed_size);
+  }
+
+  game_committed_size = committed_size;
+  valid = true;
+  if (soft_dirty_tracking) {
+    SDLx_ClearSoftDirty();
+  }
+
+  u64 end_counter = SDL_GetPerformanceCounter();
+  fprintf(stderr, "Snapshot: %zu KB in %.2f ms\n", static_cast<size_t>(copied / KB(1)),
+      1000.0f * SDLx_GetSecondsElapsed(start_counter, end_counter));
+}
+
+// Thread caches (ThreadArena, PoolMagazine) live outside the block and are not part of the
+// snapshot, and GL objects referenced from it have to still exist when it is restored.
+void SDLx_Snapshot::restore(SDLx_State &state, VirtualAllocator *game_partition) {
+  if (!valid) {
+    return;
+  }
+
+  u64 start_counter = SDL_GetPerformanceCounter();
+  void *block = state.game_memory_block;
+  size_t copied = 0;
+  auto copy_in = [&](size_t offset, size_t bytes) {
+    memcpy(memory::add(block, offset), memory::add(data, offset), bytes);
+    copied += bytes;
+  };
+
+  // Read before copying: the allocator itself is restored along with the rest of the block
+  size_t live_committed_size = game_partition->committed_size;
+  size_t common_size = live_committed_size < game_committed_size ? live_committed_size : game_committed_size;
+  if (soft_dirty_tracking) {
+    SDLx_ForEachPageRun(pagemap_fd, block, 0, state.fixed_size, pagemap_soft_dirty, copy_in);
+    SDLx_ForEachPageRun(pagemap_fd, block, state.fixed_size, common_size, pagemap_soft_dirty, copy_in);
+  } else {
+    copy_in(0, state.fixed_size + common_size);
+  }
+
+  void *game_start = memory::add(block, state.fixed_size);
+  if (game_committed_size > live_committed_size) {
+    u32 commit_flags = GAME_MEMORY_HUGE_PAGES ? memory::Commit_HugePages : memory::Commit_None;
+    bool committed = memory::commit(memory::add(game_start, live_committed_size),
+        game_committed_size - live_committed_size, commit_flags);
+    assert(committed);
+    copy_in(state.fixed_size + live_committed_size, game_committed_size - live_committed_size);
+  } else if (game_committed_size < live_committed_size) {
+    memory::decommit(memory::add(game_start, game_committed_size), live_committed_size - game_committed_size);
+  }
+
+  if (soft_dirty_tracking) {
+    SDLx_ClearSoftDirty();
+  }
+
+  u64 end_counter = SDL_GetPerformanceCounter();
+  fprintf(stderr, "Restore: %zu KB in %.2f ms\n", static_cast<size_t>(copied / KB(1)),
+      1000.0f * SDLx_GetSecondsElapsed(start_counter, end_counter));
+}
+
+void SDLx_Snapshot::release(SDLx_State &state) {
+  if (data) {
+    munmap(data, state.total_size);
+  }
+  if (fd != -1) {
+    close(fd);
+  }
+  if (pagemap_fd != -1) {
+    close(pagemap_fd);
+  }
+}
+
+internal void initializeGameSystems(GameRoot &game_root, SDLx_State &state) {
+  // Fixed size partitions are committed up front and the game partition grows on demand
+  // inside the reserved range, so resident memory follows what the game actually touches.
+  size_t fixed_size = GB(1) + MB(337);
+  size_t game_partition_size = GB(16);
+  state.total_size = fixed_size + game_partition_size;
+  void *game_memory_block = memory::reserve(state.total_size);
+  assert(game_memory_block);
+
+  u32 commit_flags = 0;
+#if GAME_MEMORY_HUGE_PAGES
+  commit_flags |= memory::Commit_HugePages;
+#endif
+#if GAME_MEMORY_PREFAULT
+  commit_flags |= memory::Commit_Prefault;
+#endif
+
+  b32 committed = memory::commit(game_memory_block, fixed_size, commit_flags);
+  assert(committed);
+
+  state.game_memory_block = game_memory_block;
+  state.fixed_size = fixed_size;
+
+  // The allocators themselves live at the start of the block, so a snapshot of the block
+  // also captures their bookkeeping.
+  auto system_partition = new (game_memory_block)
+      LinearAllocator(MB(1) - sizeof(LinearAllocator), memory::add(game_memory_block, sizeof(LinearAllocator)));
+
+  auto resource_partition = alloc<FreeListAllocator>(system_partition, GB(1), memory::add(game_memory_block, MB(1)));
+  auto frame_arena = alloc<FrameArena>(system_partition, MB(32), memory::add(game_memory_block, GB(1) + MB(1)));
+  auto job_partition =
+      alloc<ConcurrentLinearAllocator>(system_partition, MB(32), memory::add(game_memory_block, GB(1) + MB(33)));
+  auto job_pool = alloc<ConcurrentPoolAllocator>(
+      system_partition, object_pool_slot_size, 16, MB(16), memory::add(game_memory_block, GB(1) + MB(65)));
+  // Textures live in the resource heap, so the Textures tag only collects the heap's statistics
+  auto textures_tag = alloc<ProxyAllocator>(system_partition, *resource_partition, MemoryTag::Textures);
+  auto resource_heap = alloc<ResourceHeap>(system_partition, MB(256), memory::add(game_memory_block, GB(1) + MB(81)),
+                                           4096, textures_tag);
+  auto game_partition =
+      alloc<VirtualAllocator>(system_partition, game_partition_size, memory::add(game_memory_block, fixed_size));
 
   MemoryStorage memory_storage = {};
   memory_storage.resource_partition = resource_partition;
   memory_storage.game_partition = game_partition;
+  memory_storage.frame_arena = frame_arena;
+  memory_storage.job_partition = job_partition;
+  memory_storage.job_pool = job_pool;
+  memory_storage.resource_heap = resource_heap;
+
+  memory_storage.tagged_partitions[static_cast<u32>(MemoryTag::Renderer)] =
+      alloc<ProxyAllocator>(system_partition, *resource_partition, MemoryTag::Renderer);
+  memory_storage.tagged_partitions[static_cast<u32>(MemoryTag::Textures)] = textures_tag;
+  memory_storage.tagged_partitions[static_cast<u32>(MemoryTag::TileMap)] =
+      alloc<ProxyAllocator>(system_partition, *resource_partition, MemoryTag::TileMap);
+  memory_storage.tagged_partitions[static_cast<u32>(MemoryTag::Events)] =
+      alloc<ProxyAllocator>(system_partition, *resource_partition, MemoryTag::Events);
+  memory_storage.tagged_partitions[static_cast<u32>(MemoryTag::Game)] =
+      alloc<ProxyAllocator>(system_partition, *game_partition, MemoryTag::Game);
   game_root.memory_storage = memory_storage;
   game_root.renderer_api = RendererAPI::instance();
 
@@ -301,7 +562,11 @@ int main() {
   initializeGameSystems(game_root, state);
   game_root.renderer_api->init(window);
 
+  SDLx_Snapshot snapshot = {};
+  b32 snapshot_ready = snapshot.init(state);
+
   u64 last_counter = SDL_GetPerformanceCounter();
+  u64 last_page_faults = SDLx_GetPageFaultCount();
   f32 target_seconds_per_frame = 1 / game_update_hz;
   //*********** GAME LOOP *********************//
   while (g_running) {
@@ -320,26 +585,52 @@ int main() {
 
     SDLx_ProcessEvents(state, new_keyboard_controller);
 
+    if (state.snapshot_requested && snapshot_ready) {
+      snapshot.take(state, game_root.memory_storage.game_partition);
+    } else if (state.restore_requested && snapshot_ready) {
+      // Queued EventData events are not part of the snapshot, see EventDispatcher::releaseEventData
+      if (game_root.event_dispatcher) {
+        game_root.event_dispatcher->releaseEventData();
+      }
+      snapshot.restore(state, game_root.memory_storage.game_partition);
+      if (game_root.event_dispatcher) {
+        game_root.event_dispatcher->abandonEventData();
+      }
+    }
+    state.snapshot_requested = false;
+    state.restore_requested = false;
+
     if (game.updateAndRenderer) {
         game.updateAndRenderer(new_input, game_root);
     }
 
     b32 should_be_reloaded = game_code.isCodeChanged();
     if (should_be_reloaded) {
+      if (game_root.event_dispatcher) {
+        game_root.event_dispatcher->releaseEventData();
+      }
       game_code.reloadCode();
     }
 
     END_DEBUG();
     swapInput(&new_input, &old_input);
+    game_root.renderer_api->endFrame();
     SDL_GL_SwapWindow(window);
+    game_root.memory_storage.frame_arena->swap();
+    game_root.memory_storage.resource_heap->compact(RESOURCE_HEAP_COMPACT_BUDGET);
 
     u64 end_counter = SDL_GetPerformanceCounter();
     f32 measured_seconds_per_frame = SDLx_GetSecondsElapsed(last_counter, end_counter);
     target_seconds_per_frame = measured_seconds_per_frame;
     FRAME_MARKER(measured_seconds_per_frame);
     last_counter = end_counter;
+
+    u64 page_faults = SDLx_GetPageFaultCount();
+    PAGE_FAULTS(page_faults - last_page_faults);
+    last_page_faults = page_faults;
   }
 
+  snapshot.release(state);
   state.freeMemoryBlock();
   OpenGL *context = reinterpret_cast<OpenGL *>(game_root.renderer_api->getContext());
   SDL_GL_DeleteContext(context->gl_context);
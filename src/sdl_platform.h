@@ -24,9 +24,12 @@ struct SDLx_LoadedCode {
 
 struct SDLx_State {
     u64 total_size;
+    u64 fixed_size;  // committed part of the block, the game partition follows it
     void *game_memory_block;
     char *exepath;  // @Implement string
     char *past_last_exepath_slash;
+    b32 snapshot_requested;
+    b32 restore_requested;
 
     // Functions
     void setEXEPath();
@@ -34,6 +37,23 @@ struct SDLx_State {
     void freeMemoryBlock();
 };
 
+// Copy of the game memory block kept in a shared mapping. After the first snapshot only the
+// pages written since the last snapshot/restore are copied, see SDLx_Snapshot::take.
+struct SDLx_Snapshot {
+    int fd;
+    void *data;
+    int pagemap_fd;
+    b32 soft_dirty_tracking;
+    b32 valid;
+    size_t game_committed_size;
+
+    // Functions
+    b32 init(SDLx_State &state);
+    void take(SDLx_State &state, VirtualAllocator *game_partition);
+    void restore(SDLx_State &state, VirtualAllocator *game_partition);
+    void release(SDLx_State &state);
+};
+
 void SDLx_State::setEXEPath() {
     exepath = SDL_GetBasePath();
     past_last_exepath_slash = exepath;
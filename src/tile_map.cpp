@@ -99,7 +99,7 @@ internal void setTileValue(
 
   if (!tile_chunk->tiles) {
     constexpr u32 tile_count = chunk_dim * chunk_dim;
-    tile_chunk->tiles = alloc_array<u32, tile_count>(memory.game_partition);
+    tile_chunk->tiles = alloc_array<u32, tile_count>(memory.tagged(MemoryTag::TileMap));
     for (u32 i = 0; i < tile_count; ++i) {
       tile_chunk->tiles[i] = static_cast<u32>(TileValue::ACTIVE);
     }